@@ -2,13 +2,20 @@
 #include <vector>
 #include <iostream>
 #include <chrono>
+#include <span>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <bytehamster/util/XorShift64.h>
+#include <bytehamster/util/MurmurHash64.h>
 
-std::vector<std::string> generateInputData(size_t N) {
+std::vector<std::string> generateInputData(size_t N, uint64_t seed) {
     std::vector<std::string> inputData;
     inputData.reserve(N);
-    auto time = std::chrono::system_clock::now();
-    long seed = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
     bytehamster::util::XorShift64 prng(seed);
     std::cout<<"Generating input data (Seed: "<<seed<<")"<<std::endl;
     char string[200];
@@ -32,3 +39,104 @@ std::vector<std::string> generateInputData(size_t N) {
     std::cout<<"\r\033[K"<<"Input generation complete."<<std::endl;
     return inputData;
 }
+
+std::vector<uint64_t> generateIntegerInputData(size_t N, uint64_t seed) {
+    std::cout<<"Generating input data (Seed: "<<seed<<")"<<std::endl;
+    bytehamster::util::XorShift64 prng(seed);
+    std::vector<uint64_t> inputData;
+    inputData.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+        inputData.push_back(prng());
+    }
+    return inputData;
+}
+
+/**
+ * Read-only memory mapping of a whole file, so that large datasets are not copied before hashing.
+ */
+class MappedFile {
+        const char *data = nullptr;
+        size_t size = 0;
+    public:
+        explicit MappedFile(const std::string &path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Unable to open " + path);
+            }
+            struct stat fileStat = {};
+            if (fstat(fd, &fileStat) != 0) {
+                close(fd);
+                throw std::runtime_error("Unable to read size of " + path);
+            }
+            size = fileStat.st_size;
+            if (size > 0) {
+                void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    close(fd);
+                    throw std::runtime_error("Unable to map " + path);
+                }
+                madvise(mapping, size, MADV_SEQUENTIAL);
+                data = static_cast<const char *>(mapping);
+            }
+            close(fd); // The mapping stays valid
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile() {
+            if (data != nullptr) {
+                munmap(const_cast<char *>(data), size);
+            }
+        }
+
+        [[nodiscard]] std::span<const char> bytes() const {
+            return { data, size };
+        }
+};
+
+/**
+ * Keys of a file with one key per line, for example URLs or k-mers.
+ * The keys point into the mapping, which must outlive them.
+ */
+std::vector<std::string_view> splitLines(const MappedFile &file) {
+    std::string_view remaining(file.bytes().data(), file.bytes().size());
+    std::vector<std::string_view> lines;
+    while (!remaining.empty()) {
+        size_t end = remaining.find('\n');
+        std::string_view line = remaining.substr(0, end);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+        remaining.remove_prefix(end == std::string_view::npos ? remaining.size() : end + 1);
+    }
+    return lines;
+}
+
+/**
+ * Keys of a binary file of native-endian 64-bit integers, for example IDs.
+ */
+std::span<const uint64_t> asIntegers(const MappedFile &file) {
+    if (file.bytes().size() % sizeof(uint64_t) != 0) {
+        throw std::invalid_argument("File size is not a multiple of 8 bytes");
+    }
+    // Mappings are page aligned
+    return { reinterpret_cast<const uint64_t *>(file.bytes().data()), file.bytes().size() / sizeof(uint64_t) };
+}
+
+/**
+ * Same hash function as the string overloads of the hash functions.
+ */
+inline uint64_t hashKey(std::string_view key) {
+    return bytehamster::util::MurmurHash64(key.data(), key.size());
+}
+
+/**
+ * Real-world integers like IDs are not uniformly distributed, so they need to be hashed as well.
+ */
+inline uint64_t hashKey(uint64_t key) {
+    return bytehamster::util::MurmurHash64(&key, sizeof(key));
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <bytehamster/util/Function.h>
+#include <Fips.h>
+
+#if __has_include(<sux/function/RecSplit.hpp>)
+#include <sux/function/RecSplit.hpp>
+#define HAS_RECSPLIT 1
+#endif
+
+/**
+ * Standalone FiPS, with the same configuration as the fallback of the k-perfect hash function.
+ */
+class FiPSCompetitor {
+        fips::FiPS<512, uint32_t, false> phf;
+    public:
+        FiPSCompetitor(std::span<const uint64_t> keys, double gamma) : phf(keys, gamma) {
+        }
+
+        [[nodiscard]] size_t operator()(uint64_t key) const {
+            return phf(key);
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return phf.getBits();
+        }
+};
+
+/**
+ * Baseline that stores the keys themselves. The space is estimated from the node and bucket array
+ * layout of the standard library, without the overhead of the allocator.
+ */
+class UnorderedMapCompetitor {
+        std::unordered_map<uint64_t, uint32_t> map;
+    public:
+        explicit UnorderedMapCompetitor(std::span<const uint64_t> keys) {
+            map.reserve(keys.size());
+            for (size_t i = 0; i < keys.size(); i++) {
+                map.emplace(keys[i], i);
+            }
+        }
+
+        [[nodiscard]] size_t operator()(uint64_t key) const {
+            auto it = map.find(key);
+            return it == map.end() ? 0 : it->second;
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            size_t nodeBytes = sizeof(void *) + sizeof(std::pair<const uint64_t, uint32_t>);
+            return 8 * (map.bucket_count() * sizeof(void *) + map.size() * nodeBytes);
+        }
+};
+
+#ifdef HAS_RECSPLIT
+/**
+ * RecSplit from the sux library, which is not vendored. Its keys are 128-bit hashes,
+ * so the second half is derived from the 64-bit key, also for every query.
+ */
+template <size_t leafSize>
+class RecSplitCompetitor {
+        mutable sux::function::RecSplit<leafSize> phf;
+
+        static sux::function::hash128_t toHash128(uint64_t key) {
+            return {key, bytehamster::util::remix(key)};
+        }
+
+        static std::vector<sux::function::hash128_t> toHashes128(std::span<const uint64_t> keys) {
+            std::vector<sux::function::hash128_t> hashes;
+            hashes.reserve(keys.size());
+            for (uint64_t key : keys) {
+                hashes.push_back(toHash128(key));
+            }
+            return hashes;
+        }
+    public:
+        RecSplitCompetitor(std::span<const uint64_t> keys, size_t bucketSize)
+                : phf(toHashes128(keys), bucketSize) {
+        }
+
+        [[nodiscard]] size_t operator()(uint64_t key) const {
+            return phf(toHash128(key));
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return phf.getBits();
+        }
+};
+#endif
@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <bytehamster/util/XorShift64.h>
+#include <tlx/cmdline_parser.hpp>
+
+#include "BatchConsensusRecSplit.h"
+#include "consensus/Validation.h"
+
+#define DO_NOT_OPTIMIZE(value) asm volatile("" : : "r,m"(value) : "memory")
+
+size_t numSets = 1000;
+size_t minSetSize = 1000;
+size_t maxSetSize = 100000;
+size_t numQueries = 1e6;
+double spaceOverhead = 0.1;
+size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+size_t seed = 42;
+
+int main(int argc, const char* const* argv) {
+    tlx::CmdlineParser cmd;
+    cmd.add_bytes('s', "numSets", numSets, "Number of key sets");
+    cmd.add_bytes("minSetSize", minSetSize, "Smallest number of keys per set");
+    cmd.add_bytes("maxSetSize", maxSetSize, "Largest number of keys per set, sizes are log-uniformly distributed");
+    cmd.add_bytes('q', "numQueries", numQueries, "Number of queries to measure");
+    cmd.add_double('e', "overhead", spaceOverhead, "Overhead parameter");
+    cmd.add_size_t('t', "threads", numThreads, "Number of construction threads");
+    cmd.add_size_t("seed", seed, "Seed for generating keys and query plans");
+
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+    if (numSets == 0 || minSetSize == 0 || minSetSize > maxSetSize) {
+        std::cerr << "Need at least one set and 0 < minSetSize <= maxSetSize" << std::endl;
+        return 1;
+    }
+
+    std::cout<<"Generating input data"<<std::endl;
+    bytehamster::util::XorShift64 prng(seed);
+    std::vector<std::vector<uint64_t>> sets(numSets);
+    size_t numKeys = 0;
+    for (std::vector<uint64_t> &set : sets) {
+        double logSize = std::log(minSetSize) + (std::log(maxSetSize) - std::log(minSetSize)) * prng(1ul << 20) / (1ul << 20);
+        set.resize(std::clamp(size_t(std::exp(logSize)), minSetSize, maxSetSize));
+        for (uint64_t &key : set) {
+            key = prng();
+        }
+        numKeys += set.size();
+    }
+
+    std::cout<<"Constructing"<<std::endl;
+    consensus::BatchConsensusRecSplit::Parameters parameters;
+    parameters.overhead = spaceOverhead;
+    parameters.numThreads = numThreads;
+    auto beginConstruction = std::chrono::high_resolution_clock::now();
+    consensus::BatchConsensusRecSplit batch(std::span<const std::vector<uint64_t>>(sets), parameters);
+    unsigned long constructionDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - beginConstruction).count();
+
+    std::cout<<"Testing"<<std::endl;
+    for (size_t set = 0; set < numSets; set++) {
+        consensus::SpanKeySource source(sets[set]);
+        auto phf = [&](uint64_t key) { return batch(set, key); };
+        if (!consensus::validate(phf, sets[set].size(), source, 1).isMinimalPerfect()) {
+            std::cerr << "Set " << set << " is not mapped minimal perfectly!" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout<<"Preparing query plan"<<std::endl;
+    std::vector<std::pair<size_t, uint64_t>> queryPlan;
+    queryPlan.reserve(numQueries);
+    for (size_t i = 0; i < numQueries; i++) {
+        size_t set = prng(numSets);
+        queryPlan.emplace_back(set, sets[set][prng(sets[set].size())]);
+    }
+    std::cout<<"Querying"<<std::endl;
+    auto beginQueries = std::chrono::high_resolution_clock::now();
+    for (auto [set, key] : queryPlan) {
+        size_t retrieved = batch(set, key);
+        DO_NOT_OPTIMIZE(retrieved);
+    }
+    unsigned long queryDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - beginQueries).count();
+
+    std::cout << "RESULT"
+              << " method=BatchConsensus"
+              << " overhead=" << spaceOverhead
+              << " numSets=" << numSets
+              << " minSetSize=" << minSetSize
+              << " maxSetSize=" << maxSetSize
+              << " threads=" << numThreads
+              << " seed=" << seed
+              << " N=" << numKeys
+              << " numQueries=" << numQueries
+              << " queryTimeMilliseconds=" << queryDurationMs
+              << " constructionTimeMilliseconds=" << constructionDurationMs
+              << " setsPerSecond=" << 1000.0 * numSets / std::max(1ul, constructionDurationMs)
+              << " bitsPerElement=" << (double) batch.getBits() / numKeys
+              << std::endl;
+    return 0;
+}
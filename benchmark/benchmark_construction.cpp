@@ -1,138 +1,338 @@
+#include <array>
 #include <chrono>
 #include <iostream>
 #include <csignal>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <string_view>
+#include <type_traits>
 
 #include <bytehamster/util/XorShift64.h>
 #include <tlx/cmdline_parser.hpp>
 
 #include "BenchmarkData.h"
-#include "ConsensusRecSplitQueryOptimized.h"
-#include "ConsensusRecSplit.h"
+#include "Competitors.h"
+#include "DynamicConsensusRecSplit.h"
+#include "consensus/Validation.h"
 
 #define DO_NOT_OPTIMIZE(value) asm volatile("" : : "r,m"(value) : "memory")
 
+std::string method = "consensus";
 size_t numObjects = 1e6;
 size_t numQueries = 1e6;
 double spaceOverhead = 0.01;
 size_t bucketSize = 8192;
 bool useQueryOptimized = false;
+double fipsGamma = 2.0;
+size_t recSplitBucketSize = 100;
+size_t compactionTaskSize = 0;
+size_t subtreeTaskSize = 0;
+size_t seed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+size_t timeLimitSeconds = 0;
+bool showProgress = false;
+bool randomStrings = false;
+std::string stringFile;
+std::string integerFile;
 
-template <size_t k, double overhead, template<size_t, double> class Phf>
-void construct() {
-    auto time = std::chrono::system_clock::now();
-    long seed = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
-    bytehamster::util::XorShift64 prng(seed);
-    //#define STRING_KEYS
-    #ifdef STRING_KEYS
-        std::vector<std::string> keys = generateInputData(numObjects);
-    #else
-        std::cout<<"Generating input data (Seed: "<<seed<<")"<<std::endl;
-        std::vector<uint64_t> keys;
-        for (size_t i = 0; i < numObjects; i++) {
-            keys.push_back(prng());
-        }
-    #endif
+// Input, prepared once by prepareInput
+std::unique_ptr<MappedFile> mappedFile;
+std::vector<std::string> generatedStrings;
+std::vector<uint64_t> generatedIntegers;
+std::vector<std::string_view> stringKeys;
+std::span<const uint64_t> integerKeys;
+std::span<const uint64_t> hashedKeys;
+std::string keySource;
+unsigned long hashingDurationMs = 0;
 
-    std::cout<<"Constructing"<<std::endl;
-    sleep(1);
-    auto beginConstruction = std::chrono::high_resolution_clock::now();
-    Phf<k, overhead> hashFunc(keys);
-    unsigned long constructionDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::high_resolution_clock::now() - beginConstruction).count();
+template <size_t k>
+using ConsensusRecSplitCompacted64 = consensus::ConsensusRecSplit<k, consensus::RUNTIME_OVERHEAD, 0, 64>;
 
-    std::cout<<"Testing"<<std::endl;
-    std::vector<bool> taken(keys.size(), false);
-    for (size_t i = 0; i < keys.size(); i++) {
-        size_t hash = hashFunc(keys.at(i));
-        if (taken[hash]) {
-            std::cerr << "Collision by key " << i << "!" << std::endl;
-            exit(1);
-        } else if (hash > numObjects) {
-            std::cerr << "Out of range!" << std::endl;
-            exit(1);
+template <size_t k>
+using ConsensusRecSplitSubtrees4096 = consensus::ConsensusRecSplit<k, consensus::RUNTIME_OVERHEAD, 0, 0, 4096>;
+
+constexpr size_t QUERY_BATCH_SIZE = 64;
+
+struct QueryDurations {
+    unsigned long singleMs;
+    unsigned long batchedMs;
+};
+
+/**
+ * Uses the batched query of the hash function if it has one, otherwise queries the keys one by one.
+ */
+template <typename HashFunc>
+void queryBatch(const HashFunc &hashFunc, std::span<const uint64_t> keys, std::span<size_t> result) {
+    if constexpr (requires { hashFunc(keys, result); }) {
+        hashFunc(keys, result);
+    } else {
+        for (size_t i = 0; i < keys.size(); i++) {
+            result[i] = hashFunc(keys[i]);
         }
-        taken[hash] = true;
     }
+}
 
+/**
+ * Queries the keys of the plan, one by one and in batches of QUERY_BATCH_SIZE.
+ * Keys that were hashed for construction are also hashed as part of each query.
+ */
+template <bool hashKeys, typename HashFunc, typename Key>
+QueryDurations measureQueries(const HashFunc &hashFunc, std::span<const Key> keys, bytehamster::util::XorShift64 &prng) {
     std::cout<<"Preparing query plan"<<std::endl;
-    #ifdef STRING_KEYS
-        std::vector<std::string> queryPlan;
-    #else
-        std::vector<uint64_t> queryPlan;
-    #endif
+    std::vector<Key> queryPlan;
     queryPlan.reserve(numQueries);
     for (size_t i = 0; i < numQueries; i++) {
-        queryPlan.push_back(keys[prng(numObjects)]);
+        queryPlan.push_back(keys[prng(keys.size())]);
     }
 
     std::cout<<"Querying"<<std::endl;
     sleep(1);
     auto beginQueries = std::chrono::high_resolution_clock::now();
-    for (const auto &key : queryPlan) {
-        size_t retrieved = hashFunc(key);
-        DO_NOT_OPTIMIZE(retrieved);
+    for (const Key &key : queryPlan) {
+        if constexpr (hashKeys) {
+            size_t retrieved = hashFunc(hashKey(key));
+            DO_NOT_OPTIMIZE(retrieved);
+        } else {
+            size_t retrieved = hashFunc(key);
+            DO_NOT_OPTIMIZE(retrieved);
+        }
     }
-    auto queryDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+    unsigned long singleMs = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::high_resolution_clock::now() - beginQueries).count();
 
+    std::cout<<"Querying batched"<<std::endl;
+    sleep(1);
+    std::array<uint64_t, QUERY_BATCH_SIZE> batchKeys;
+    std::array<size_t, QUERY_BATCH_SIZE> batchResult;
+    auto beginBatchedQueries = std::chrono::high_resolution_clock::now();
+    for (size_t batchStart = 0; batchStart < queryPlan.size(); batchStart += QUERY_BATCH_SIZE) {
+        size_t batchSize = std::min(QUERY_BATCH_SIZE, queryPlan.size() - batchStart);
+        for (size_t i = 0; i < batchSize; i++) {
+            if constexpr (hashKeys) {
+                batchKeys[i] = hashKey(queryPlan[batchStart + i]);
+            } else {
+                batchKeys[i] = queryPlan[batchStart + i];
+            }
+        }
+        queryBatch(hashFunc, std::span<const uint64_t>(batchKeys.data(), batchSize),
+                   std::span<size_t>(batchResult.data(), batchSize));
+        DO_NOT_OPTIMIZE(batchResult);
+    }
+    unsigned long batchedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - beginBatchedQueries).count();
+    return {singleMs, batchedMs};
+}
+
+/**
+ * The parameters are passed to the constructor of the hash function, before the construction options
+ * if it takes them. The parameter fields describe the configuration in the result line.
+ */
+template <typename Phf, typename... Parameters>
+void construct(const std::string &methodName, const std::string &parameterFields, const Parameters &...parameters) {
+    std::cout<<"Constructing"<<std::endl;
+    sleep(1);
+    consensus::ConstructionOptions options;
+    if (timeLimitSeconds > 0) {
+        options.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeLimitSeconds);
+    }
+    if (showProgress) {
+        options.onProgress = [](const consensus::ConstructionProgress &progress) {
+            std::cout << "Progress: " << int(100 * progress.fractionDone) << "%";
+            if (progress.remaining.has_value()) {
+                std::cout << ", about " << std::chrono::duration<double>(*progress.remaining).count() << " s remaining";
+            }
+            std::cout << std::endl;
+        };
+    }
+    auto beginConstruction = std::chrono::high_resolution_clock::now();
+    Phf hashFunc = [&] {
+        if constexpr (std::is_constructible_v<Phf, std::span<const uint64_t>, Parameters..., consensus::ConstructionOptions>) {
+            return Phf(hashedKeys, parameters..., options);
+        } else {
+            return Phf(hashedKeys, parameters...);
+        }
+    }();
+    unsigned long constructionDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - beginConstruction).count();
+
+    std::cout<<"Testing"<<std::endl;
+    consensus::SpanKeySource source(hashedKeys);
+    consensus::ValidationResult validation = consensus::validate(hashFunc, hashedKeys.size(), source);
+    if (validation.outOfRange > 0) {
+        std::cerr << "Out of range by key " << validation.firstOutOfRange.front() << "!" << std::endl;
+        exit(1);
+    } else if (validation.collisions > 0) {
+        std::cerr << "Collision by key " << validation.firstCollisions.front().keyIndices.back() << "!" << std::endl;
+        exit(1);
+    }
+
+    bytehamster::util::XorShift64 prng(seed);
+    QueryDurations queryDurations;
+    if (!stringKeys.empty()) {
+        queryDurations = measureQueries<true>(hashFunc, std::span<const std::string_view>(stringKeys), prng);
+    } else if (!integerKeys.empty()) {
+        queryDurations = measureQueries<true>(hashFunc, integerKeys, prng);
+    } else {
+        queryDurations = measureQueries<false>(hashFunc, hashedKeys, prng);
+    }
+
     std::cout << "RESULT"
-              << " method=Consensus" + std::string(useQueryOptimized ? "QueryOptimized" : "")
-              << " overhead=" << overhead
-              << " k=" << k
-              << " N=" << numObjects
+              << " method=" << methodName
+              << parameterFields
+              << " keys=" << keySource
+              << " seed=" << seed
+              << " N=" << hashedKeys.size()
               << " numQueries=" << numQueries
-              << " queryTimeMilliseconds=" << queryDurationMs
+              << " queryTimeMilliseconds=" << queryDurations.singleMs
+              << " batchedQueryTimeMilliseconds=" << queryDurations.batchedMs
+              << " queriesPerSecond=" << 1000.0 * numQueries / std::max(1ul, queryDurations.singleMs)
+              << " batchedQueriesPerSecond=" << 1000.0 * numQueries / std::max(1ul, queryDurations.batchedMs)
+              << " hashingTimeMilliseconds=" << hashingDurationMs
               << " constructionTimeMilliseconds=" << constructionDurationMs
-              << " bitsPerElement=" << (double) hashFunc.getBits() / numObjects
+              << " bitsPerElement=" << (double) hashFunc.getBits() / hashedKeys.size()
               << std::endl;
 }
 
-template <size_t k, double overhead, template<size_t, double> class Phf>
-void dispatchBucketSize(size_t param) {
-    if constexpr (k <= 16) {
-        std::cerr << "The parameter " << param << " for k was not compiled into this binary." << std::endl;
-    } else if (k == param) {
-        construct<k, overhead, Phf>();
+/**
+ * Generates or loads the keys and hashes string keys to 64 bits, which is timed separately from the construction.
+ */
+void prepareInput() {
+    if (!stringFile.empty()) {
+        std::cout<<"Loading "<<stringFile<<std::endl;
+        mappedFile = std::make_unique<MappedFile>(stringFile);
+        stringKeys = splitLines(*mappedFile);
+        keySource = "stringFile";
+    } else if (!integerFile.empty()) {
+        std::cout<<"Loading "<<integerFile<<std::endl;
+        mappedFile = std::make_unique<MappedFile>(integerFile);
+        integerKeys = asIntegers(*mappedFile);
+        keySource = "integerFile";
+    } else if (randomStrings) {
+        generatedStrings = generateInputData(numObjects, seed);
+        stringKeys.assign(generatedStrings.begin(), generatedStrings.end());
+        keySource = "randomStrings";
     } else {
-        dispatchBucketSize<k / 2, overhead, Phf>(param);
+        generatedIntegers = generateIntegerInputData(numObjects, seed);
+        hashedKeys = generatedIntegers;
+        keySource = "randomIntegers";
+    }
+
+    if (!stringKeys.empty() || !integerKeys.empty()) {
+        std::cout<<"Hashing"<<std::endl;
+        auto beginHashing = std::chrono::high_resolution_clock::now();
+        generatedIntegers.resize(stringKeys.size() + integerKeys.size());
+        for (size_t i = 0; i < stringKeys.size(); i++) {
+            generatedIntegers[i] = hashKey(stringKeys[i]);
+        }
+        for (size_t i = 0; i < integerKeys.size(); i++) {
+            generatedIntegers[i] = hashKey(integerKeys[i]);
+        }
+        hashingDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::high_resolution_clock::now() - beginHashing).count();
+        hashedKeys = generatedIntegers;
+    }
+
+    std::vector<uint64_t> sortedKeys(hashedKeys.begin(), hashedKeys.end());
+    std::sort(sortedKeys.begin(), sortedKeys.end());
+    if (std::adjacent_find(sortedKeys.begin(), sortedKeys.end()) != sortedKeys.end()) {
+        throw std::invalid_argument("Input contains duplicate keys or 64-bit hash collisions");
     }
 }
 
-template <template<size_t, double> class Phf>
-void dispatchSpaceOverhead(double spaceOverhead, size_t bucketSize) {
-    if (spaceOverhead == 0.5) {
-        dispatchBucketSize<1ul << 15, 0.5, Phf>(bucketSize);
-    } else if (spaceOverhead == 0.3) {
-        dispatchBucketSize<1ul << 15, 0.3, Phf>(bucketSize);
-    } else if (spaceOverhead == 0.1) {
-        dispatchBucketSize<1ul << 15, 0.1, Phf>(bucketSize);
-    } else if (spaceOverhead == 0.03) {
-        dispatchBucketSize<1ul << 15, 0.03, Phf>(bucketSize);
-    } else if (spaceOverhead == 0.01) {
-        dispatchBucketSize<1ul << 15, 0.01, Phf>(bucketSize);
-    } else if (spaceOverhead == 0.001) {
-        dispatchBucketSize<1ul << 15, 0.001, Phf>(bucketSize);
+std::string consensusParameterFields() {
+    std::ostringstream fields;
+    fields << " compactionTaskSize=" << compactionTaskSize
+           << " subtreeTaskSize=" << subtreeTaskSize
+           << " overhead=" << spaceOverhead
+           << " k=" << bucketSize;
+    return fields.str();
+}
+
+template <size_t k, template<size_t> class Phf>
+void dispatchBucketSize(size_t param) {
+    if constexpr (k <= 16) {
+        std::cerr << "The parameter " << param << " for k was not compiled into this binary." << std::endl;
+    } else if (k == param) {
+        construct<Phf<k>>("Consensus", consensusParameterFields(), spaceOverhead);
     } else {
-        std::cerr << "The parameter " << spaceOverhead << " for spaceOverhead was not compiled into this binary." << std::endl;
+        dispatchBucketSize<k / 2, Phf>(param);
     }
 }
 
 int main(int argc, const char* const* argv) {
     tlx::CmdlineParser cmd;
-    cmd.add_bytes('n', "numObjects", numObjects, "Number of objects to construct with");
+    cmd.add_string('m', "method", method, "Hash function to measure (consensus, recsplit, fips or unorderedmap)");
+    cmd.add_bytes('n', "numObjects", numObjects, "Number of objects to generate, files are used completely");
     cmd.add_bytes('k', "bucketSize", bucketSize, "Bucket size of the initial partitioning");
     cmd.add_bytes('q', "numQueries", numQueries, "Number of queries to measure");
     cmd.add_double('e', "overhead", spaceOverhead, "Overhead parameter");
     cmd.add_flag('o', "queryOptimized", useQueryOptimized, "Use the query optimized version");
+    cmd.add_bytes('c', "compactionTaskSize", compactionTaskSize, "Compact keys to 32 bits for tasks of this size (0 or 64)");
+    cmd.add_bytes('s', "subtreeTaskSize", subtreeTaskSize, "Construct subtrees of this size one by one (0 or 4096)");
+    cmd.add_double("fipsGamma", fipsGamma, "Gamma parameter of FiPS");
+    cmd.add_bytes("recSplitBucketSize", recSplitBucketSize, "Bucket size of RecSplit, its leaf size is 8");
+    cmd.add_size_t("timeLimit", timeLimitSeconds, "Abort Consensus constructions that take longer than this many seconds");
+    cmd.add_flag("progress", showProgress, "Print the progress and estimated remaining time of the construction");
+    cmd.add_size_t("seed", seed, "Seed for generating keys and query plans, defaults to the current time");
+    cmd.add_flag("randomStrings", randomStrings, "Generate random strings instead of random 64-bit integers");
+    cmd.add_string('f', "stringFile", stringFile, "Load newline-separated string keys instead of generating them");
+    cmd.add_string('i', "integerFile", integerFile, "Load binary 64-bit integer keys instead of generating them");
 
     if (!cmd.process(argc, argv)) {
         return 1;
     }
 
-    if (useQueryOptimized) {
-        dispatchSpaceOverhead<consensus::ConsensusRecSplitQueryOptimized>(spaceOverhead, bucketSize);
-    } else {
-        dispatchSpaceOverhead<consensus::ConsensusRecSplit>(spaceOverhead, bucketSize);
+    if (compactionTaskSize != 0 && subtreeTaskSize != 0) {
+        std::cerr << "Compaction and subtree construction cannot be combined in this binary." << std::endl;
+        return 1;
+    }
+
+    prepareInput();
+
+    try {
+        if (method == "recsplit") {
+#ifdef HAS_RECSPLIT
+            construct<RecSplitCompetitor<8>>("RecSplit",
+                    " leafSize=8 bucketSize=" + std::to_string(recSplitBucketSize), recSplitBucketSize);
+#else
+            std::cerr << "RecSplit was not found at compile time, set SUX_INCLUDE_DIR to a checkout of sux." << std::endl;
+            return 1;
+#endif
+        } else if (method == "fips") {
+            std::ostringstream fields;
+            fields << " gamma=" << fipsGamma;
+            construct<FiPSCompetitor>("FiPS", fields.str(), fipsGamma);
+        } else if (method == "unorderedmap") {
+            construct<UnorderedMapCompetitor>("UnorderedMap", "");
+        } else if (method != "consensus") {
+            std::cerr << "Unknown method " << method << std::endl;
+            return 1;
+        } else if (useQueryOptimized || (subtreeTaskSize == 0 && compactionTaskSize == 0)) {
+            consensus::DynamicConsensusRecSplit::Parameters parameters;
+            parameters.k = bucketSize;
+            parameters.overhead = spaceOverhead;
+            parameters.variant = useQueryOptimized ? consensus::DynamicConsensusRecSplit::Variant::QueryOptimized
+                                                   : consensus::DynamicConsensusRecSplit::Variant::Levelwise;
+            construct<consensus::DynamicConsensusRecSplit>(
+                    "Consensus" + std::string(useQueryOptimized ? "QueryOptimized" : ""), consensusParameterFields(), parameters);
+        } else if (subtreeTaskSize == 4096) {
+            dispatchBucketSize<1ul << 15, ConsensusRecSplitSubtrees4096>(bucketSize);
+        } else if (subtreeTaskSize != 0) {
+            std::cerr << "The parameter " << subtreeTaskSize << " for subtreeTaskSize was not compiled into this binary." << std::endl;
+            return 1;
+        } else if (compactionTaskSize == 64) {
+            dispatchBucketSize<1ul << 15, ConsensusRecSplitCompacted64>(bucketSize);
+        } else {
+            std::cerr << "The parameter " << compactionTaskSize << " for compactionTaskSize was not compiled into this binary." << std::endl;
+            return 1;
+        }
+    } catch (const consensus::ConstructionInterrupted &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
     }
 
     return 0;
@@ -0,0 +1,107 @@
+#include <chrono>
+#include <iostream>
+#include <bytehamster/util/XorShift64.h>
+#include <tlx/cmdline_parser.hpp>
+#include "consensus/BumpedKPerfectHashFunction.h"
+
+#define DO_NOT_OPTIMIZE(value) asm volatile("" : : "r,m"(value) : "memory")
+
+size_t numObjects = 10'000'000;
+size_t numQueries = 1e6;
+size_t bucketSize = 8192;
+
+template <typename F>
+double nanosecondsPerQuery(F query) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < numQueries; i++) {
+        size_t retrieved = query(i);
+        DO_NOT_OPTIMIZE(retrieved);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - begin).count() / numQueries;
+}
+
+template <size_t k>
+void benchmark() {
+    bytehamster::util::XorShift64 prng(42);
+    std::cout<<"Generating input data"<<std::endl;
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < numObjects; i++) {
+        keys.push_back(prng());
+    }
+    consensus::BumpedKPerfectHashFunction<k> hashFunc(keys);
+    std::vector<uint64_t> fallbackKeys;
+    for (uint64_t key : keys) {
+        if (hashFunc.isFallback(key)) {
+            fallbackKeys.push_back(key);
+        }
+    }
+    if (fallbackKeys.empty()) {
+        std::cerr << "No fallback keys" << std::endl;
+        return;
+    }
+    std::vector<uint64_t> allPlan;
+    std::vector<uint64_t> fallbackPlan;
+    std::vector<size_t> indexPlan;
+    for (size_t i = 0; i < numQueries; i++) {
+        allPlan.push_back(keys[prng(keys.size())]);
+        fallbackPlan.push_back(fallbackKeys[prng(fallbackKeys.size())]);
+        indexPlan.push_back(prng(fallbackKeys.size()));
+    }
+
+    std::cout<<"Querying"<<std::endl;
+    const consensus::FreePositions &chosen = hashFunc.getFreePositions();
+    double allKeys = nanosecondsPerQuery([&](size_t i) { return hashFunc(allPlan[i]); });
+    double fallbackKeysTime = nanosecondsPerQuery([&](size_t i) { return hashFunc(fallbackPlan[i]); });
+    std::cout << "RESULT"
+              << " method=BumpedKPerfectFallback"
+              << " k=" << k
+              << " N=" << numObjects
+              << " fallbackKeys=" << fallbackKeys.size()
+              << " strategy=" << consensus::FreePositions::strategyName(chosen.strategy())
+              << " allKeysNanosecondsPerQuery=" << allKeys
+              << " fallbackKeysNanosecondsPerQuery=" << fallbackKeysTime
+              << std::endl;
+
+    // Only the free position mapping, for each strategy on the same positions
+    std::vector<size_t> positions = chosen.toVector();
+    for (auto strategy : { consensus::FreePositions::Strategy::SORTED_ARRAY,
+                           consensus::FreePositions::Strategy::ELIAS_FANO,
+                           consensus::FreePositions::Strategy::RANK_SELECT }) {
+        consensus::FreePositions freePositions;
+        freePositions.build(positions, strategy);
+        double mappingTime = nanosecondsPerQuery([&](size_t i) { return freePositions.at(indexPlan[i]); });
+        std::cout << "RESULT"
+                  << " method=FreePositions"
+                  << " k=" << k
+                  << " N=" << numObjects
+                  << " fallbackKeys=" << fallbackKeys.size()
+                  << " strategy=" << consensus::FreePositions::strategyName(strategy)
+                  << " nanosecondsPerQuery=" << mappingTime
+                  << " bitsPerElement=" << (double) freePositions.getBits() / numObjects
+                  << std::endl;
+    }
+}
+
+template <size_t k>
+void dispatchBucketSize(size_t param) {
+    if constexpr (k <= 16) {
+        std::cerr << "The parameter " << param << " for k was not compiled into this binary." << std::endl;
+    } else if (k == param) {
+        benchmark<k>();
+    } else {
+        dispatchBucketSize<k / 2>(param);
+    }
+}
+
+int main(int argc, const char* const* argv) {
+    tlx::CmdlineParser cmd;
+    cmd.add_bytes('n', "numObjects", numObjects, "Number of objects to construct with");
+    cmd.add_bytes('k', "bucketSize", bucketSize, "Bucket size of the k-perfect hash function");
+    cmd.add_bytes('q', "numQueries", numQueries, "Number of queries to measure");
+
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+    dispatchBucketSize<1ul << 15>(bucketSize);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include <bytehamster/util/XorShift64.h>
+#include <tlx/cmdline_parser.hpp>
+
+#include "ConsensusRecSplit.h"
+#include "consensus/HotSwapHandle.h"
+
+#define DO_NOT_OPTIMIZE(value) asm volatile("" : : "r,m"(value) : "memory")
+
+size_t numObjects = 1e6;
+size_t numThreads = 4;
+size_t pinBatchSize = 1;
+size_t phaseSeconds = 5;
+
+// Fast to rebuild, so that the writer can swap often
+using Phf = consensus::ConsensusRecSplit<2048, 0.1>;
+using Handle = consensus::HotSwapHandle<Phf>;
+
+/**
+ * Runs the readers for one phase and returns the number of queries per second.
+ * The writer, if given, runs concurrently until the readers are done.
+ */
+template <typename Writer>
+double runPhase(Handle &handle, const std::vector<uint64_t> &keys, Writer writer) {
+    std::atomic<bool> stop = false;
+    std::atomic<size_t> totalQueries = 0;
+    std::vector<std::thread> readers;
+    for (size_t t = 0; t < numThreads; t++) {
+        readers.emplace_back([&, t] {
+            Handle::Reader reader = handle.registerReader();
+            bytehamster::util::XorShift64 prng(t + 1);
+            size_t queries = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto pin = reader.pin();
+                for (size_t i = 0; i < pinBatchSize; i++) {
+                    size_t retrieved = pin->operator()(keys[prng(keys.size())]);
+                    if (retrieved >= keys.size()) {
+                        std::cerr << "Out of range!" << std::endl;
+                        exit(1);
+                    }
+                    DO_NOT_OPTIMIZE(retrieved);
+                }
+                queries += pinBatchSize;
+            }
+            totalQueries += queries;
+        });
+    }
+    std::thread writerThread([&] { writer(stop); });
+    auto begin = std::chrono::high_resolution_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(phaseSeconds));
+    stop = true;
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+    writerThread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+    return totalQueries / seconds;
+}
+
+int main(int argc, const char* const* argv) {
+    tlx::CmdlineParser cmd;
+    cmd.add_bytes('n', "numObjects", numObjects, "Number of objects to construct with");
+    cmd.add_size_t('t', "threads", numThreads, "Number of query threads");
+    cmd.add_size_t('b', "pinBatchSize", pinBatchSize, "Number of queries per pin of the current instance");
+    cmd.add_size_t('d', "seconds", phaseSeconds, "Duration of each phase");
+
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+
+    bytehamster::util::XorShift64 prng(42);
+    std::cout<<"Generating input data"<<std::endl;
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < numObjects; i++) {
+        keys.push_back(prng());
+    }
+    std::cout<<"Constructing"<<std::endl;
+    Handle handle(std::make_unique<Phf>(keys, consensus::ConstructionOptions{ .quiet = true }), numThreads);
+
+    std::cout<<"Querying without swaps"<<std::endl;
+    double baselineQueriesPerSecond = runPhase(handle, keys, [] (std::atomic<bool> &) {});
+
+    std::cout<<"Querying while rebuilding and swapping"<<std::endl;
+    size_t swaps = 0;
+    size_t maxRetired = 0;
+    double swappingQueriesPerSecond = runPhase(handle, keys, [&] (std::atomic<bool> &stop) {
+        while (!stop.load(std::memory_order_relaxed)) {
+            handle.publish(std::make_unique<Phf>(keys, consensus::ConstructionOptions{ .quiet = true }));
+            maxRetired = std::max(maxRetired, handle.retiredInstances());
+            swaps++;
+        }
+    });
+    handle.tryCollect(); // Readers are done, so this frees all retired instances
+
+    std::cout << "RESULT"
+              << " method=HotSwap"
+              << " N=" << numObjects
+              << " threads=" << numThreads
+              << " pinBatchSize=" << pinBatchSize
+              << " baselineQueriesPerSecond=" << baselineQueriesPerSecond
+              << " swappingQueriesPerSecond=" << swappingQueriesPerSecond
+              << " swaps=" << swaps
+              << " maxRetired=" << maxRetired
+              << " retiredAtEnd=" << handle.retiredInstances()
+              << std::endl;
+    return 0;
+}
@@ -2,39 +2,181 @@
 #include <iostream>
 #include <csignal>
 #include <bytehamster/util/XorShift64.h>
+#include <tlx/cmdline_parser.hpp>
 #include "consensus/BumpedKPerfectHashFunction.h"
+#include "consensus/FrozenBucketing.h"
 
-int main() {
-    constexpr size_t k = 32768;
+#define DO_NOT_OPTIMIZE(value) asm volatile("" : : "r,m"(value) : "memory")
 
-    auto time = std::chrono::system_clock::now();
-    long seed = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
-    bytehamster::util::XorShift64 prng(seed);
-    std::cout<<"Generating input data (Seed: "<<seed<<")"<<std::endl;
-    std::vector<uint64_t> keys;
-    for (size_t i = 0; i < 10'000'000; i++) {
-        keys.push_back(prng());
-    }
-    consensus::BumpedKPerfectHashFunction<k> hashFunc(keys);
+size_t bucketSize = 32768;
+size_t numObjects = 10'000'000;
+size_t numQueries = 1e6;
+bool sweep = false;
+size_t seed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+template <size_t k, typename Parameters>
+void benchmark(const std::vector<uint64_t> &keys) {
+    std::cout<<"Constructing (k="<<k<<", overloadFactor="<<Parameters::OVERLOAD_FACTOR
+             <<", thresholdTrimming="<<Parameters::THRESHOLD_TRIMMING<<", thresholdBits="<<Parameters::THRESHOLD_BITS
+             <<", numLayers="<<Parameters::NUM_LAYERS<<")"<<std::endl;
+    auto beginConstruction = std::chrono::high_resolution_clock::now();
+    consensus::BumpedKPerfectHashFunction<k, Parameters> hashFunc(keys);
+    unsigned long constructionDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - beginConstruction).count();
 
     std::cout<<"Testing"<<std::endl;
-    std::vector<size_t> taken(keys.size() / k, 0);
-    size_t perfectFallback = 0;
+    size_t nbuckets = keys.size() / k;
+    std::vector<size_t> taken(nbuckets, 0);
+    // Keys of the last half-filled bucket get distinct values behind the full buckets
+    std::vector<bool> takenEndBucket(keys.size() - nbuckets * k, false);
+    size_t fallbackKeys = 0;
     for (size_t i = 0; i < keys.size(); i++) {
         size_t hash = hashFunc(keys.at(i));
-        if (hash >= keys.size() / k) {
-            perfectFallback++;
-        } else if (taken[hash] >= k) {
-            std::cerr << "Collision by key " << i << "!" << std::endl;
-            exit(1);
-        } else {
+        fallbackKeys += hashFunc.isFallback(keys.at(i));
+        if (hash < nbuckets) {
+            if (taken[hash] >= k) {
+                std::cerr << "Collision by key " << i << "!" << std::endl;
+                exit(1);
+            }
             taken[hash]++;
+        } else if (hash >= nbuckets * k && hash < keys.size()) {
+            if (takenEndBucket[hash - nbuckets * k]) {
+                std::cerr << "Collision in the last bucket by key " << i << "!" << std::endl;
+                exit(1);
+            }
+            takenEndBucket[hash - nbuckets * k] = true;
+        } else {
+            std::cerr << "Key " << i << " has hash value " << hash << ", which is out of range" << std::endl;
+            exit(1);
         }
     }
-    if (perfectFallback >= k) {
-        std::cerr << "Too many fallback" << std::endl;
-        exit(1);
-    }
     hashFunc.printBits();
+    consensus::FrozenBucketing<decltype(hashFunc)> frozen(hashFunc);
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (frozen(keys[i]) != hashFunc(keys[i])) {
+            std::cerr << "Frozen representation differs for key " << i << "!" << std::endl;
+            exit(1);
+        }
+    }
+
+    bytehamster::util::XorShift64 prng(42);
+    std::vector<uint64_t> queryPlan;
+    queryPlan.reserve(numQueries);
+    for (size_t i = 0; i < numQueries; i++) {
+        queryPlan.push_back(keys[prng(keys.size())]);
+    }
+    auto beginQueries = std::chrono::high_resolution_clock::now();
+    for (uint64_t key : queryPlan) {
+        size_t retrieved = hashFunc(key);
+        DO_NOT_OPTIMIZE(retrieved);
+    }
+    auto queryDuration = std::chrono::high_resolution_clock::now() - beginQueries;
+    auto queryDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(queryDuration).count();
+
+    auto beginFrozenQueries = std::chrono::high_resolution_clock::now();
+    for (uint64_t key : queryPlan) {
+        size_t retrieved = frozen(key);
+        DO_NOT_OPTIMIZE(retrieved);
+    }
+    auto frozenQueryDuration = std::chrono::high_resolution_clock::now() - beginFrozenQueries;
+
+    std::cout << "RESULT"
+              << " method=BumpedKPerfect"
+              << " k=" << k
+              << " overloadFactor=" << Parameters::OVERLOAD_FACTOR
+              << " thresholdTrimming=" << Parameters::THRESHOLD_TRIMMING
+              << " thresholdBits=" << Parameters::THRESHOLD_BITS
+              << " numLayers=" << Parameters::NUM_LAYERS
+              << " N=" << keys.size()
+              << " seed=" << seed
+              << " numQueries=" << numQueries
+              << " queryTimeMilliseconds=" << queryDurationMs
+              << " queriesPerSecond=" << numQueries / std::chrono::duration<double>(queryDuration).count()
+              << " nanosecondsPerQuery=" << std::chrono::duration<double, std::nano>(queryDuration).count() / numQueries
+              << " frozenNanosecondsPerQuery="
+                    << std::chrono::duration<double, std::nano>(frozenQueryDuration).count() / numQueries
+              << " constructionTimeMilliseconds=" << constructionDurationMs
+              << " fallbackKeys=" << fallbackKeys
+              << " bitsPerElement=" << (double) hashFunc.getBits() / keys.size()
+              << " frozenBitsPerElement=" << (double) frozen.getBits() / keys.size()
+              << std::endl;
+}
+
+template <size_t k, double overloadFactor, size_t thresholdTrimming, size_t thresholdBits, size_t numLayers>
+void benchmarkParameters(const std::vector<uint64_t> &keys) {
+    benchmark<k, consensus::BumpingParameters<overloadFactor, thresholdTrimming, thresholdBits, numLayers>>(keys);
+}
+
+/**
+ * Varies one parameter at a time, keeping the others at their default for k.
+ */
+template <size_t k>
+void benchmarkSweep(const std::vector<uint64_t> &keys) {
+    using Default = consensus::DefaultBumpingParameters<k>;
+    constexpr double overload = Default::OVERLOAD_FACTOR;
+    constexpr size_t trimming = Default::THRESHOLD_TRIMMING;
+    constexpr size_t bits = Default::THRESHOLD_BITS;
+    constexpr size_t layers = Default::NUM_LAYERS;
+    benchmarkParameters<k, overload, trimming, bits, layers>(keys);
+
+    benchmarkParameters<k, 0.85, trimming, bits, layers>(keys);
+    benchmarkParameters<k, 0.9, trimming, bits, layers>(keys);
+    benchmarkParameters<k, 0.95, trimming, bits, layers>(keys);
+    benchmarkParameters<k, 0.97, trimming, bits, layers>(keys);
+    benchmarkParameters<k, 0.99, trimming, bits, layers>(keys);
+
+    benchmarkParameters<k, overload, 2, bits, layers>(keys);
+    benchmarkParameters<k, overload, 4, bits, layers>(keys);
+    benchmarkParameters<k, overload, 8, bits, layers>(keys);
+    benchmarkParameters<k, overload, 16, bits, layers>(keys);
+
+    benchmarkParameters<k, overload, trimming, bits - 2, layers>(keys);
+    benchmarkParameters<k, overload, trimming, bits - 1, layers>(keys);
+    benchmarkParameters<k, overload, trimming, bits + 1, layers>(keys);
+
+    benchmarkParameters<k, overload, trimming, bits, 1>(keys);
+    benchmarkParameters<k, overload, trimming, bits, 3>(keys);
+}
+
+template <size_t k>
+void benchmarkBucketSize(const std::vector<uint64_t> &keys) {
+    if (sweep) {
+        benchmarkSweep<k>(keys);
+        return;
+    }
+    benchmark<k, consensus::DefaultBumpingParameters<k>>(keys);
+}
+
+int main(int argc, const char* const* argv) {
+    tlx::CmdlineParser cmd;
+    cmd.add_bytes('n', "numObjects", numObjects, "Number of objects to construct with");
+    cmd.add_bytes('k', "bucketSize", bucketSize, "Bucket size (256, 1024, 8192 or 32768)");
+    cmd.add_bytes('q', "numQueries", numQueries, "Number of queries to measure");
+    cmd.add_flag("sweep", sweep, "Vary the bumping parameters instead of using the defaults for k");
+    cmd.add_size_t("seed", seed, "Seed for generating keys, defaults to the current time");
+
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+
+    bytehamster::util::XorShift64 prng(seed);
+    std::cout<<"Generating input data (Seed: "<<seed<<")"<<std::endl;
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < numObjects; i++) {
+        keys.push_back(prng());
+    }
+    if (bucketSize == 256) {
+        benchmarkBucketSize<256>(keys);
+    } else if (bucketSize == 1024) {
+        benchmarkBucketSize<1024>(keys);
+    } else if (bucketSize == 8192) {
+        benchmarkBucketSize<8192>(keys);
+    } else if (bucketSize == 32768) {
+        benchmarkBucketSize<32768>(keys);
+    } else {
+        std::cerr << "The parameter " << bucketSize << " for k was not compiled into this binary." << std::endl;
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,132 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include <bytehamster/util/XorShift64.h>
+#include <tlx/cmdline_parser.hpp>
+
+#include "ConsensusRecSplit.h"
+#include "consensus/SplitHash.h"
+
+#define DO_NOT_OPTIMIZE(value) asm volatile("" : : "r,m"(value) : "memory")
+
+size_t numObjects = 1e6;
+size_t numTrials = 1e7;
+// Consecutive seeds tried on the same keys, like in the search
+constexpr size_t SEEDS_PER_TASK = 64;
+
+/**
+ * Probability that a random split of n keys is balanced, C(n, n/2) / 2^n.
+ */
+double balancedProbability(size_t n) {
+    return std::exp(std::lgamma(n + 1) - 2 * std::lgamma(n / 2 + 1) - n * std::log(2.0));
+}
+
+template <typename SplitHash, size_t n>
+void benchmarkTrials() {
+    bytehamster::util::XorShift64 prng(42);
+    std::array<uint64_t, n> keys;
+    size_t numTasks = std::max<size_t>(1, numTrials / n / SEEDS_PER_TASK);
+    size_t successes = 0;
+    size_t trials = 0;
+    std::chrono::nanoseconds duration(0);
+    for (size_t task = 0; task < numTasks; task++) {
+        for (uint64_t &key : keys) {
+            key = prng();
+        }
+        uint64_t firstSeed = prng();
+        auto begin = std::chrono::high_resolution_clock::now();
+        for (uint64_t seed = firstSeed; seed < firstSeed + SEEDS_PER_TASK; seed++) {
+            uint64_t hashedSeed = SplitHash::hashSeed(seed);
+            size_t numToLeft = 0;
+            for (size_t i = 0; i < n; i++) {
+                numToLeft += SplitHash::toLeft(keys[i], hashedSeed);
+            }
+            successes += numToLeft == n / 2;
+        }
+        duration += std::chrono::high_resolution_clock::now() - begin;
+        trials += SEEDS_PER_TASK;
+    }
+    DO_NOT_OPTIMIZE(successes);
+
+    double expectedFailureRate = 1 - balancedProbability(n);
+    double failureRate = 1 - (double) successes / trials;
+    double standardDeviation = std::sqrt(expectedFailureRate * (1 - expectedFailureRate) / trials);
+    std::cout << "RESULT"
+              << " method=SplitTrials"
+              << " splitHash=" << SplitHash::NAME
+              << " taskSize=" << n
+              << " trials=" << trials
+              << " trialsPerSecond=" << trials / std::chrono::duration<double>(duration).count()
+              << " failureRate=" << failureRate
+              << " expectedFailureRate=" << expectedFailureRate
+              << " deviationSigma=" << (failureRate - expectedFailureRate) / standardDeviation
+              << std::endl;
+}
+
+template <typename SplitHash>
+void benchmarkConstruction(const std::vector<uint64_t> &keys) {
+    std::cout<<"Constructing with "<<SplitHash::NAME<<std::endl;
+    auto beginConstruction = std::chrono::high_resolution_clock::now();
+    consensus::ConsensusRecSplit<8192, 0.01, 0, 0, 0, SplitHash> hashFunc(keys);
+    unsigned long constructionDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - beginConstruction).count();
+
+    std::vector<bool> taken(keys.size(), false);
+    for (size_t i = 0; i < keys.size(); i++) {
+        size_t hash = hashFunc(keys[i]);
+        if (hash >= keys.size() || taken[hash]) {
+            std::cerr << "Collision by key " << i << "!" << std::endl;
+            exit(1);
+        }
+        taken[hash] = true;
+    }
+
+    auto beginQueries = std::chrono::high_resolution_clock::now();
+    for (uint64_t key : keys) {
+        size_t retrieved = hashFunc(key);
+        DO_NOT_OPTIMIZE(retrieved);
+    }
+    auto queryDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - beginQueries).count();
+
+    std::cout << "RESULT"
+              << " method=SplitConstruction"
+              << " splitHash=" << SplitHash::NAME
+              << " N=" << keys.size()
+              << " constructionTimeMilliseconds=" << constructionDurationMs
+              << " queryTimeMilliseconds=" << queryDurationMs
+              << " bitsPerElement=" << (double) hashFunc.getBits() / keys.size()
+              << std::endl;
+}
+
+template <typename SplitHash>
+void benchmark(const std::vector<uint64_t> &keys) {
+    benchmarkTrials<SplitHash, 2>();
+    benchmarkTrials<SplitHash, 4>();
+    benchmarkTrials<SplitHash, 8>();
+    benchmarkTrials<SplitHash, 32>();
+    benchmarkTrials<SplitHash, 128>();
+    benchmarkTrials<SplitHash, 1024>();
+    benchmarkConstruction<SplitHash>(keys);
+}
+
+int main(int argc, const char* const* argv) {
+    tlx::CmdlineParser cmd;
+    cmd.add_bytes('n', "numObjects", numObjects, "Number of objects to construct with");
+    cmd.add_bytes('t', "numTrials", numTrials, "Number of key evaluations per task size");
+
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+
+    bytehamster::util::XorShift64 prng(42);
+    std::cout<<"Generating input data"<<std::endl;
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < numObjects; i++) {
+        keys.push_back(prng());
+    }
+    benchmark<consensus::RemixSplitHash>(keys);
+    benchmark<consensus::MultiplyShiftSplitHash>(keys);
+    return 0;
+}
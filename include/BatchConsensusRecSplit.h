@@ -0,0 +1,369 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <bytehamster/util/MurmurHash64.h>
+
+#include "ConsensusRecSplitQueryOptimized.h"
+#include "consensus/RunThreads.h"
+#include "consensus/ScratchArena.h"
+#include "consensus/Serialization.h"
+
+namespace consensus {
+/**
+ * Many independent perfect hash functions on small key sets, for example one per partition of a data set.
+ * The functions are constructed concurrently, each with a k that suits the size of its set.
+ * They are stored as plain arrays (see BumpedKPerfectHashFunction::toArrays) in one contiguous blob,
+ * and a directory entry per set locates the arrays of its function.
+ * This needs no objects or heap allocations per set, and loading does not need the keys.
+ * Function i maps the keys of set i to [0, numKeys(i)).
+ */
+class BatchConsensusRecSplit {
+    public:
+        static constexpr size_t MIN_K = 64;
+        static constexpr size_t MAX_K = 4096;
+        static constexpr uint64_t MAGIC = 0x4843544253524e43; // "CNRSBTCH"
+
+        struct Parameters {
+            double overhead = 0.1;
+            size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+            // Requesting a stop makes the construction throw ConstructionInterrupted
+            std::stop_token stopToken = {};
+        };
+
+        /**
+         * Location of the function of one set. Starting at the offset, the blob contains the seeds,
+         * the thresholds (two per word), the layers, the fallback hashes and the fallback results.
+         */
+        struct Entry {
+            uint64_t offset;
+            uint32_t numKeys;
+            uint32_t seedWords;
+            uint32_t numFallback;
+            uint16_t k;
+            uint16_t numLayers;
+        };
+    private:
+        template <size_t... logks>
+        static std::tuple<QueryOptimizedLayout<(MIN_K << logks)>...> makeLayouts(double overhead,
+                                                                                 std::index_sequence<logks...>) {
+            return std::make_tuple(QueryOptimizedLayout<(MIN_K << logks)>(overhead)...);
+        }
+        using Layouts = decltype(makeLayouts(0, std::make_index_sequence<intLog2(MAX_K / MIN_K) + 1>()));
+
+        template <size_t... logks>
+        static std::variant<std::unique_ptr<BumpedKPerfectHashFunction<(MIN_K << logks)>>...> makeBucketing(
+                std::index_sequence<logks...>);
+        // Bucketing function of a set, for the k that was chosen for it
+        using Bucketing = decltype(makeBucketing(std::make_index_sequence<std::tuple_size_v<Layouts>>()));
+
+        double overhead;
+        Layouts layouts;
+        std::vector<Entry> directory;
+        std::vector<uint64_t> blob;
+    public:
+        BatchConsensusRecSplit(std::span<const std::span<const uint64_t>> sets, const Parameters &parameters)
+                : overhead(checkOverhead(parameters.overhead)),
+                  layouts(makeLayouts(overhead, std::make_index_sequence<std::tuple_size_v<Layouts>>())),
+                  directory(sets.size()) {
+            construct(sets, parameters);
+        }
+
+        BatchConsensusRecSplit(std::span<const std::vector<uint64_t>> sets, const Parameters &parameters)
+                : BatchConsensusRecSplit(std::vector<std::span<const uint64_t>>(sets.begin(), sets.end()), parameters) {
+        }
+
+        /**
+         * Load an instance that was written using writeToStream.
+         */
+        explicit BatchConsensusRecSplit(std::istream &is)
+                : overhead(checkOverhead(readHeader(is))),
+                  layouts(makeLayouts(overhead, std::make_index_sequence<std::tuple_size_v<Layouts>>())),
+                  directory(readVector<Entry>(is)), blob(readVector<uint64_t>(is)) {
+            for (const Entry &entry : directory) {
+                checkEntry(entry);
+            }
+        }
+
+        void writeToStream(std::ostream &os) const {
+            writeValue(os, MAGIC);
+            writeValue<double>(os, overhead);
+            writeVector(os, directory);
+            writeVector(os, blob);
+        }
+
+        [[nodiscard]] size_t numSets() const {
+            return directory.size();
+        }
+
+        [[nodiscard]] size_t numKeys(size_t set) const {
+            return directory[set].numKeys;
+        }
+
+        [[nodiscard]] const Entry &getEntry(size_t set) const {
+            return directory[set];
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return 64 * blob.size() + 8 * sizeof(Entry) * directory.size();
+        }
+
+        [[nodiscard]] size_t operator()(size_t set, const std::string &key) const {
+            return this->operator()(set, bytehamster::util::MurmurHash64(key));
+        }
+
+        [[nodiscard]] size_t operator()(size_t set, uint64_t key) const {
+            const Entry &entry = directory[set];
+            return dispatch(entry.k, [&]<size_t k>() { return query<k>(entry, key); });
+        }
+
+    private:
+        static double checkOverhead(double overhead) {
+            if (!(overhead > 0)) {
+                throw std::invalid_argument("Overhead must be positive");
+            }
+            return overhead;
+        }
+
+        static double readHeader(std::istream &is) {
+            if (readValue<uint64_t>(is) != MAGIC) {
+                throw std::invalid_argument("Not a serialized BatchConsensusRecSplit");
+            }
+            return readValue<double>(is);
+        }
+
+        template <size_t k = MAX_K, typename Function>
+        static auto dispatch(size_t entryK, Function function) -> decltype(function.template operator()<MIN_K>()) {
+            if constexpr (k == MIN_K) {
+                return function.template operator()<k>();
+            } else if (entryK == k) {
+                return function.template operator()<k>();
+            } else {
+                return dispatch<k / 2>(entryK, function);
+            }
+        }
+
+        /**
+         * Words of the given number of values, with the values packed into the words.
+         */
+        template <typename T>
+        static size_t numWords(size_t numValues) {
+            return (numValues * sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        }
+
+        template <typename T>
+        static void append(std::vector<uint64_t> &words, std::span<const T> values) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            size_t begin = words.size();
+            words.resize(begin + numWords<T>(values.size()));
+            std::memcpy(words.data() + begin, values.data(), values.size() * sizeof(T));
+        }
+
+        template <size_t k>
+        using Phf = ConsensusRecSplitQueryOptimized<k, RUNTIME_OVERHEAD>;
+
+        template <size_t k>
+        using LayerInfo = typename BumpedKPerfectHashFunction<k>::LayerInfo;
+
+        template <size_t k>
+        static constexpr size_t MAX_LAYERS = DefaultBumpingParameters<k>::NUM_LAYERS + 1;
+
+        /**
+         * Values packed into the words of the blob. The words are uint64_t,
+         * so the values are copied out instead of accessing the words through a pointer to T.
+         */
+        template <typename T>
+        struct PackedView {
+            static_assert(std::is_trivially_copyable_v<T>);
+            const uint64_t *words;
+
+            [[nodiscard]] T operator[](size_t i) const {
+                T value;
+                std::memcpy(&value, reinterpret_cast<const unsigned char *>(words) + i * sizeof(T), sizeof(T));
+                return value;
+            }
+        };
+
+        template <size_t k>
+        static size_t entryWords(const Entry &entry) {
+            return entry.seedWords + numWords<uint32_t>(std::max(1ul, size_t(entry.numKeys) / k))
+                    + numWords<LayerInfo<k>>(entry.numLayers) + 2 * size_t(entry.numFallback);
+        }
+
+        void checkEntry(const Entry &entry) const {
+            if (entry.k < MIN_K || entry.k > MAX_K || !std::has_single_bit(entry.k)
+                    || entry.numLayers == 0 || dispatch(entry.k, [&]<size_t k>() { return entry.numLayers > MAX_LAYERS<k>; })
+                    || entry.offset > blob.size()
+                    || dispatch(entry.k, [&]<size_t k>() { return entryWords<k>(entry); }) > blob.size() - entry.offset) {
+                throw std::invalid_argument("Invalid directory entry");
+            }
+            size_t seedBits = dispatch(entry.k, [&]<size_t k>() {
+                return (entry.numKeys / k) * std::get<QueryOptimizedLayout<k>>(layouts).totalSize();
+            });
+            if (64 * entry.seedWords != UnalignedBitVector(seedBits).bitSize()) {
+                throw std::invalid_argument("Invalid seed vector size");
+            }
+        }
+
+        /**
+         * Chooses the k for which the arrays of the set need the fewest words, and returns the bucketing function
+         * for it. The n mod k keys after the last full bucket and the keys that the bucketing function bumps
+         * are stored with their hash and result, so they dominate the space for small sets,
+         * and the number of bumped keys is hard to predict. Therefore, this builds the bucketing function
+         * for the candidates, which is much cheaper than the seed search. The construction then uses the one
+         * of the chosen k. Candidates are tried by increasing size without bumped keys,
+         * and skipped once that is no improvement. The directory entry has the same size for all k.
+         */
+        [[nodiscard]] Bucketing chooseBucketing(std::span<const uint64_t> keys,
+                                                std::pmr::memory_resource *scratch) const {
+            std::vector<std::pair<size_t, size_t>> candidates; // Words without bumped keys, k
+            for (size_t candidate = MIN_K; candidate <= std::min(MAX_K, keys.size()); candidate *= 2) {
+                size_t words = dispatch(candidate, [&]<size_t k>() {
+                    size_t seedBits = (keys.size() / k) * std::get<QueryOptimizedLayout<k>>(layouts).totalSize();
+                    return UnalignedBitVector(seedBits).bitSize() / 64
+                            + numWords<uint32_t>(std::max(1ul, keys.size() / k)) + 2 * (keys.size() % k);
+                });
+                candidates.emplace_back(words, candidate);
+            }
+            std::sort(candidates.begin(), candidates.end());
+            Bucketing best;
+            size_t bestWords = std::numeric_limits<size_t>::max();
+            for (auto [wordsWithoutBumped, candidate] : candidates) {
+                if (wordsWithoutBumped >= bestWords) {
+                    break;
+                }
+                dispatch(candidate, [&]<size_t k>() {
+                    auto bucketing = std::make_unique<BumpedKPerfectHashFunction<k>>(keys, scratch);
+                    typename BumpedKPerfectHashFunction<k>::Arrays arrays = bucketing->toArrays();
+                    size_t words = wordsWithoutBumped + numWords<LayerInfo<k>>(arrays.layers.size())
+                            + 2 * (arrays.fallbackHashes.size() - keys.size() % k);
+                    if (words < bestWords) {
+                        bestWords = words;
+                        best = std::move(bucketing);
+                    }
+                });
+            }
+            if (bestWords == std::numeric_limits<size_t>::max()) {
+                // Fewer than MIN_K keys
+                best = std::make_unique<BumpedKPerfectHashFunction<MIN_K>>(keys, scratch);
+            }
+            return best;
+        }
+
+        /**
+         * Constructs the function of one set and appends its arrays to the words of this thread.
+         * The offset of the entry refers to these words until all sets are constructed.
+         */
+        template <size_t k>
+        void constructSet(std::span<const uint64_t> keys, std::unique_ptr<BumpedKPerfectHashFunction<k>> bucketing,
+                          const ConstructionOptions &options, std::vector<uint64_t> &words, Entry &entry) const {
+            Phf<k> phf(keys, std::move(bucketing), overhead, options);
+            typename BumpedKPerfectHashFunction<k>::Arrays arrays = phf.bucketingPhf->toArrays();
+            entry.offset = words.size();
+            entry.numKeys = keys.size();
+            entry.seedWords = phf.unalignedBitVector.words().size();
+            entry.numFallback = arrays.fallbackHashes.size();
+            entry.k = k;
+            entry.numLayers = arrays.layers.size();
+            append(words, phf.unalignedBitVector.words());
+            append<uint32_t>(words, arrays.thresholds);
+            append<LayerInfo<k>>(words, arrays.layers);
+            append<uint64_t>(words, arrays.fallbackHashes);
+            append<uint64_t>(words, arrays.fallbackResults);
+        }
+
+        /**
+         * The threads take the next set from a shared counter and write to their own words,
+         * which are concatenated in the order of the sets afterwards.
+         */
+        void construct(std::span<const std::span<const uint64_t>> sets, const Parameters &parameters) {
+            size_t numThreads = std::max(1ul, std::min(parameters.numThreads, sets.size()));
+            std::vector<std::vector<uint64_t>> threadWords(numThreads);
+            std::vector<uint32_t> threadOfSet(sets.size());
+            std::atomic<size_t> nextThread = 0;
+            std::atomic<size_t> nextSet = 0;
+            std::atomic<bool> failed = false;
+            runThreads(numThreads, [&] {
+                size_t thread = nextThread++;
+                ScratchArena arena;
+                ConstructionOptions options;
+                options.stopToken = parameters.stopToken;
+                options.quiet = true;
+                options.scratch = &arena;
+                try {
+                    for (size_t set = nextSet++; set < sets.size() && !failed; set = nextSet++) {
+                        if (parameters.stopToken.stop_requested()) {
+                            throw ConstructionInterrupted(ConstructionInterrupted::Reason::Cancelled,
+                                                          (double) set / sets.size());
+                        }
+                        if (sets[set].size() > std::numeric_limits<uint32_t>::max()) {
+                            throw std::invalid_argument("Set " + std::to_string(set) + " has too many keys");
+                        }
+                        Bucketing bucketing = chooseBucketing(sets[set], &arena);
+                        std::visit([&]<size_t k>(std::unique_ptr<BumpedKPerfectHashFunction<k>> &bucketingOfK) {
+                            constructSet<k>(sets[set], std::move(bucketingOfK), options, threadWords[thread],
+                                            directory[set]);
+                        }, bucketing);
+                        threadOfSet[set] = thread;
+                        arena.reset();
+                    }
+                } catch (...) {
+                    failed = true;
+                    throw;
+                }
+            });
+
+            size_t totalWords = 0;
+            for (const std::vector<uint64_t> &words : threadWords) {
+                totalWords += words.size();
+            }
+            blob.resize(totalWords);
+            size_t offset = 0;
+            for (size_t set = 0; set < sets.size(); set++) {
+                Entry &entry = directory[set];
+                size_t size = dispatch(entry.k, [&]<size_t k>() { return entryWords<k>(entry); });
+                std::memcpy(blob.data() + offset, threadWords[threadOfSet[set]].data() + entry.offset,
+                            size * sizeof(uint64_t));
+                entry.offset = offset;
+                offset += size;
+            }
+        }
+
+        template <size_t k>
+        [[nodiscard]] size_t query(const Entry &entry, uint64_t key) const {
+            const uint64_t *words = blob.data() + entry.offset;
+            std::span<const uint64_t> seeds(words, entry.seedWords);
+            words += entry.seedWords;
+            PackedView<uint32_t> thresholds(words);
+            words += numWords<uint32_t>(std::max(1ul, size_t(entry.numKeys) / k));
+            std::array<LayerInfo<k>, MAX_LAYERS<k>> layerArray;
+            std::memcpy(layerArray.data(), words, entry.numLayers * sizeof(LayerInfo<k>));
+            std::span<const LayerInfo<k>> layers(layerArray.data(), entry.numLayers);
+            words += numWords<LayerInfo<k>>(entry.numLayers);
+            std::span<const uint64_t> fallbackHashes(words, entry.numFallback);
+            std::span<const uint64_t> fallbackResults(words + entry.numFallback, entry.numFallback);
+            return Phf<k>::queryArrays(std::get<QueryOptimizedLayout<k>>(layouts), key, entry.numKeys, seeds,
+                                       thresholds, layers, fallbackHashes, fallbackResults);
+        }
+};
+} // namespace consensus
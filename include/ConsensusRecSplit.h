@@ -2,8 +2,16 @@
 
 #include <cstdint>
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <type_traits>
+#include <memory>
+#include <memory_resource>
 #include <fstream>
 #include <span>
+#include <optional>
+#include <bit>
+#include <utility>
 
 #include <ips2ra.hpp>
 #include <bytehamster/util/MurmurHash64.h>
@@ -11,38 +19,149 @@
 
 #include "consensus/UnalignedBitVector.h"
 #include "consensus/SplittingTreeStorageLevelwise.h"
+#include "consensus/SplittingTreeStorageQueryOptimized.h"
 #include "consensus/BumpedKPerfectHashFunction.h"
+#include "consensus/FingerprintArray.h"
+#include "consensus/ConstructionOptions.h"
+#include "consensus/SplitHash.h"
 
 namespace consensus {
 /**
  * Perfect hash function using the consensus idea: Combined search and encoding of successful seeds.
  * <code>k</code> is the size of each RecSplit base case and must be a power of 2.
+ * With <code>fingerprintBits</code> > 0, a fingerprint of each key is stored at its output position,
+ * so that <code>contains</code> can reject keys outside the input set with false positive rate 2^-fingerprintBits.
+ * With <code>compactionTaskSize</code> > 0, the keys are replaced by 32-bit hashes once the tasks have at most
+ * that size, which halves the memory traffic of the lower levels. The hashes must not collide within a task,
+ * so the number of keys times compactionTaskSize must be at most 2^34. Otherwise, the construction throws
+ * std::invalid_argument, see compactKeys.
+ * With <code>subtreeTaskSize</code> > 0, the levels are only constructed level by level until the tasks have
+ * that size. Each of these subtrees is then finished before starting the next one, like the buckets of
+ * ConsensusRecSplitQueryOptimized, so its keys stay in cache instead of being streamed once per level.
+ * <code>SplitHash</code> is the function that splits the keys of a task, see SplitHash.h.
+ * With <code>overhead</code> = RUNTIME_OVERHEAD, the overhead is a constructor argument instead.
  */
-template <size_t k, double overhead>
+template <size_t k, double overhead, size_t fingerprintBits = 0, size_t compactionTaskSize = 0,
+          size_t subtreeTaskSize = 0, typename SplitHash = RemixSplitHash>
 class ConsensusRecSplit {
     public:
         static_assert(1ul << intLog2(k) == k, "k must be a power of 2");
-        static_assert(overhead > 0);
+        static_assert(overhead > 0 || overhead == RUNTIME_OVERHEAD);
+        static_assert(compactionTaskSize == 0 || 1ul << intLog2(compactionTaskSize) == compactionTaskSize,
+                      "compactionTaskSize must be a power of 2");
+        static_assert(subtreeTaskSize == 0 || (subtreeTaskSize >= 2 && 1ul << intLog2(subtreeTaskSize) == subtreeTaskSize),
+                      "subtreeTaskSize must be a power of 2");
         static constexpr size_t logk = intLog2(k);
+        static constexpr uint64_t MAGIC = 0x574c564c53524e43; // Start of serialized instances, "CNRSLVLW"
+        // First level that works on compacted keys, or logk if disabled
+        static constexpr size_t COMPACTION_LEVEL = compactionTaskSize == 0 ? logk
+                : logk - std::min(logk, intLog2(compactionTaskSize));
+        // First level that is constructed subtree by subtree, or logk if disabled
+        static constexpr size_t SUBTREE_LEVEL = subtreeTaskSize == 0 ? logk
+                : logk - std::min(logk, intLog2(subtreeTaskSize));
+        static constexpr size_t SUBTREE_SIZE = 1ul << (logk - SUBTREE_LEVEL);
+        static_assert(COMPACTION_LEVEL == logk || COMPACTION_LEVEL <= SUBTREE_LEVEL,
+                      "Keys can only be compacted before the subtree phase");
+        // Only take space with RUNTIME_OVERHEAD
+        [[no_unique_address]] OverheadBudget<LevelwiseLayout<k>, overhead> budget;
+        [[no_unique_address]] OverheadBudget<QueryOptimizedLayout<SUBTREE_SIZE>, overhead> subtreeBudget;
         size_t numKeys = 0;
+        uint64_t compactionSeed = 0;
+        // Levels from SUBTREE_LEVEL on are stored in subtreeSeeds instead
         std::array<UnalignedBitVector, logk> unalignedBitVectors;
-        BumpedKPerfectHashFunction<k> *bucketingPhf = nullptr;
+        UnalignedBitVector subtreeSeeds;
+        std::unique_ptr<BumpedKPerfectHashFunction<k>> bucketingPhf;
+        FingerprintArray<fingerprintBits> fingerprints;
 
-        explicit ConsensusRecSplit(std::span<const std::string> keys) : numKeys(keys.size()) {
+        explicit ConsensusRecSplit(std::span<const std::string> keys) requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplit(keys, ConstructionOptions()) {
+        }
+
+        explicit ConsensusRecSplit(std::span<const uint64_t> keys) requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplit(keys, ConstructionOptions()) {
+        }
+
+        /**
+         * Construct while periodically writing the completed levels and the current search position to a file.
+         * If the checkpoint file already exists, the construction resumes from there.
+         * The file is deleted after a successful construction.
+         */
+        ConsensusRecSplit(std::span<const std::string> keys, const CheckpointConfig &checkpointConfig)
+                requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplit(keys, ConstructionOptions{ .checkpoint = checkpointConfig }) {
+        }
+
+        ConsensusRecSplit(std::span<const uint64_t> keys, const CheckpointConfig &checkpointConfig)
+                requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplit(keys, ConstructionOptions{ .checkpoint = checkpointConfig }) {
+        }
+
+        /**
+         * Construct with cancellation, a deadline, progress reports and checkpoints, see ConstructionOptions.
+         * Throws ConstructionInterrupted if the construction is stopped.
+         */
+        ConsensusRecSplit(std::span<const std::string> keys, const ConstructionOptions &options)
+                requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplit(keys, overhead, options) {
+        }
+
+        ConsensusRecSplit(std::span<const uint64_t> keys, const ConstructionOptions &options)
+                requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplit(keys, overhead, options) {
+        }
+
+        /**
+         * Construct with an overhead that is only known at runtime, see RUNTIME_OVERHEAD.
+         * With a compile-time overhead, the argument must be equal to it.
+         */
+        ConsensusRecSplit(std::span<const std::string> keys, double runtimeOverhead,
+                          const ConstructionOptions &options = ConstructionOptions())
+                : budget(runtimeOverhead), subtreeBudget(runtimeOverhead), numKeys(keys.size()), fingerprints(numKeys) {
             std::vector<uint64_t> hashedKeys;
             hashedKeys.reserve(keys.size());
             for (const std::string &key : keys) {
                 hashedKeys.push_back(bytehamster::util::MurmurHash64(key));
             }
-            startSearch(hashedKeys);
+            ConstructionMonitor monitor(options, [&] { return checkpointIdentifier(hashedKeys); });
+            startSearch(hashedKeys, monitor);
+            monitor.finish();
+        }
+
+        ConsensusRecSplit(std::span<const uint64_t> keys, double runtimeOverhead,
+                          const ConstructionOptions &options = ConstructionOptions())
+                : budget(runtimeOverhead), subtreeBudget(runtimeOverhead), numKeys(keys.size()), fingerprints(numKeys) {
+            ConstructionMonitor monitor(options, [&] { return checkpointIdentifier(keys); });
+            startSearch(keys, monitor);
+            monitor.finish();
         }
 
-        explicit ConsensusRecSplit(std::span<const uint64_t> keys) : numKeys(keys.size()) {
-            startSearch(keys);
+        /**
+         * Load an instance that was written using writeToStream.
+         */
+        explicit ConsensusRecSplit(std::istream &is)
+                : ConsensusRecSplit(is, readHeader(is)) {
         }
 
-        ~ConsensusRecSplit() {
-            delete bucketingPhf;
+    private:
+        struct Header {
+            double serializedOverhead;
+            size_t numKeys;
+        };
+
+        ConsensusRecSplit(std::istream &is, Header header)
+                : budget(header.serializedOverhead), subtreeBudget(header.serializedOverhead), numKeys(header.numKeys),
+                  compactionSeed(readValue<uint64_t>(is)), fingerprints(numKeys) {
+            for (UnalignedBitVector &unalignedBitVector : unalignedBitVectors) {
+                unalignedBitVector.readFromStream(is);
+            }
+            subtreeSeeds.readFromStream(is);
+            bucketingPhf = std::make_unique<BumpedKPerfectHashFunction<k>>(is);
+            fingerprints.readFromStream(is);
+        }
+
+    public:
+        [[nodiscard]] double getOverhead() const {
+            return budget.getOverhead();
         }
 
         [[nodiscard]] size_t getBits() const {
@@ -50,7 +169,8 @@ class ConsensusRecSplit {
             for (const UnalignedBitVector &v : unalignedBitVectors) {
                 bits += v.bitSize();
             }
-            return bits + bucketingPhf->getBits();
+            bits += subtreeSeeds.bitSize();
+            return bits + bucketingPhf->getBits() + fingerprints.getBits();
         }
 
         [[nodiscard]] size_t operator()(const std::string &key) const {
@@ -64,8 +184,11 @@ class ConsensusRecSplit {
                 return bucket; // Fallback if numKeys does not divide n
             }
             size_t taskIdx = bucket;
-            for (size_t level = 0; level < logk; level++) {
-                size_t seedEndPos = SplittingTreeStorageLevelwise<k, overhead>::seedStartPosition(level, taskIdx + 1);
+            for (size_t level = 0; level < SUBTREE_LEVEL; level++) {
+                if (level == COMPACTION_LEVEL) {
+                    key = compactKey(key);
+                }
+                size_t seedEndPos = budget.layout.seedStartPosition(level, taskIdx + 1);
                 uint64_t seed = unalignedBitVectors.at(level).readAt(seedEndPos);
                 if (toLeft(key, seed)) {
                     taskIdx = 2 * taskIdx;
@@ -73,18 +196,120 @@ class ConsensusRecSplit {
                     taskIdx = 2 * taskIdx + 1;
                 }
             }
+            if constexpr (SUBTREE_LEVEL < logk) {
+                if constexpr (COMPACTION_LEVEL == SUBTREE_LEVEL) {
+                    key = compactKey(key);
+                }
+                // taskIdx is now the subtree
+                SubtreeTask task(subtreeBudget.layout, 0, 0, taskIdx, nbuckets * (k / SUBTREE_SIZE));
+                for (size_t level = 0; level < SubtreeTask::logn; level++) {
+                    task.setLevel(level);
+                    if (toLeft(key, subtreeSeeds.readAt(task.endPosition))) {
+                        task.index = 2 * task.index;
+                    } else {
+                        task.index = 2 * task.index + 1;
+                    }
+                }
+                return taskIdx * SUBTREE_SIZE + task.index;
+            }
             return taskIdx;
         }
 
+        /**
+         * Returns false if the key is definitely not part of the input set.
+         * Keys outside the input set return true with probability 2^-fingerprintBits.
+         */
+        [[nodiscard]] bool contains(const std::string &key) const requires (fingerprintBits > 0) {
+            return contains(bytehamster::util::MurmurHash64(key));
+        }
+
+        [[nodiscard]] bool contains(uint64_t key) const requires (fingerprintBits > 0) {
+            size_t position = this->operator()(key);
+            return fingerprints.matches(position, fingerprintKey(key, position));
+        }
+
+        /**
+         * Batched membership check. Evaluates the hash function for a chunk of keys before
+         * comparing fingerprints, so that the independent memory accesses can overlap.
+         */
+        void contains(std::span<const uint64_t> keys, std::span<bool> result) const requires (fingerprintBits > 0) {
+            assert(result.size() >= keys.size());
+            constexpr size_t CHUNK = 64;
+            std::array<size_t, CHUNK> positions;
+            for (size_t chunkStart = 0; chunkStart < keys.size(); chunkStart += CHUNK) {
+                size_t chunkSize = std::min(CHUNK, keys.size() - chunkStart);
+                for (size_t i = 0; i < chunkSize; i++) {
+                    positions[i] = this->operator()(keys[chunkStart + i]);
+                }
+                for (size_t i = 0; i < chunkSize; i++) {
+                    result[chunkStart + i] = fingerprints.matches(positions[i], fingerprintKey(keys[chunkStart + i], positions[i]));
+                }
+            }
+        }
+
+        /**
+         * Serialize this instance.
+         */
+        void writeToStream(std::ostream &os) const {
+            writeValue(os, MAGIC);
+            writeValue<uint64_t>(os, k);
+            writeValue<double>(os, budget.getOverhead());
+            writeValue<uint64_t>(os, fingerprintBits);
+            writeValue<uint64_t>(os, compactionTaskSize);
+            writeValue<uint64_t>(os, subtreeTaskSize);
+            writeValue<uint64_t>(os, SplitHash::ID);
+            writeValue<uint64_t>(os, numKeys);
+            writeValue<uint64_t>(os, compactionSeed);
+            for (const UnalignedBitVector &unalignedBitVector : unalignedBitVectors) {
+                unalignedBitVector.writeToStream(os);
+            }
+            subtreeSeeds.writeToStream(os);
+            bucketingPhf->writeToStream(os);
+            fingerprints.writeToStream(os);
+        }
+
     private:
-        void startSearch(std::span<const uint64_t> keys) {
-            bucketingPhf = new BumpedKPerfectHashFunction<k>(keys);
+        static constexpr size_t MONITOR_CHECK_INTERVAL = 1ul << 16; // Seed trials between polling the monitor
+
+        using SubtreeTask = SplittingTaskIteratorQueryOptimized<SUBTREE_SIZE>;
+
+        /**
+         * In the subtree phase, level is SUBTREE_LEVEL and task is the subtree.
+         */
+        struct SearchPosition {
+            size_t level = 0;
+            size_t task = 0;
+            size_t subtreeLevel = 0;
+            size_t subtreeIndex = 0;
+        };
+
+        void startSearch(std::span<const uint64_t> keys, ConstructionMonitor &monitor) {
+            if constexpr (COMPACTION_LEVEL < logk) {
+                // Checked before doing any work, see compactKeys
+                constexpr size_t taskSize = 1ul << (logk - COMPACTION_LEVEL);
+                if (keys.size() > (1ul << 34) / taskSize) {
+                    throw std::invalid_argument("Too many keys for compactionTaskSize " + std::to_string(taskSize)
+                                                + ", the number of keys times compactionTaskSize must be at most 2^34");
+                }
+            }
+            std::optional<SearchPosition> resumePosition;
+            if (std::optional<std::ifstream> is = monitor.openCheckpoint()) {
+                resumePosition = readCheckpoint(*is);
+                if (!monitor.quiet()) {
+                    std::cout << "Resuming from level " << resumePosition->level
+                              << ", task " << resumePosition->task << std::endl;
+                }
+            }
+
+            // Deterministic, so we do not need to store it in the checkpoint
+            bucketingPhf = std::make_unique<BumpedKPerfectHashFunction<k>>(keys, monitor.scratch());
             size_t nbuckets = keys.size() / k;
-            std::vector<size_t> counters(nbuckets);
+            std::pmr::vector<size_t> counters(nbuckets, monitor.scratch());
             std::vector<uint64_t> modifiableKeys(nbuckets * k); // Note that this is possibly fewer than n
             for (uint64_t key : keys) {
                 size_t bucket = bucketingPhf->operator()(key);
                 if (bucket >= nbuckets) {
+                    fingerprints.set(bucket, key);
                     continue; // No need to handle this key
                 }
                 modifiableKeys.at(bucket * k + counters.at(bucket)) = key;
@@ -97,52 +322,375 @@ class ConsensusRecSplit {
             #endif
 
             if (!modifiableKeys.empty()) {
-                constructLevel<0>(modifiableKeys);
+                constructFromLevel<0>(modifiableKeys, monitor, resumePosition);
+            }
+        }
+
+        /**
+         * Continue the construction at the given level, compacting the keys first if this is the compaction level.
+         */
+        template <size_t level, typename Key>
+        void constructFromLevel(std::vector<Key> &keys, ConstructionMonitor &monitor,
+                                std::optional<SearchPosition> resumePosition) {
+            if constexpr (level == logk) {
+                if constexpr (fingerprintBits > 0) {
+                    storeFingerprints(keys);
+                }
+            } else if constexpr (level == COMPACTION_LEVEL && std::is_same_v<Key, uint64_t>) {
+                std::vector<uint32_t> compactedKeys = compactKeys(keys);
+                if (!monitor.quiet()) {
+                    std::cout << "Compacted keys to 32 bits at level " << COMPACTION_LEVEL
+                              << " (attempt " << compactionSeed << ")" << std::endl;
+                }
+                keys.clear();
+                keys.shrink_to_fit();
+                constructFromLevel<level>(compactedKeys, monitor, resumePosition);
+            } else if constexpr (level == SUBTREE_LEVEL) {
+                constructSubtrees(keys, monitor, resumePosition);
+                constructFromLevel<logk>(keys, monitor, resumePosition);
+            } else {
+                constructLevel<level>(keys, monitor, resumePosition);
+            }
+        }
+
+        [[nodiscard]] inline uint64_t compactKey(uint64_t key) const {
+            return bytehamster::util::remix(key + compactionSeed + 0x8ae3c9a5f1d26b47ul) >> 32;
+        }
+
+        /**
+         * Fingerprints of the keys in the splitting tree are computed after compaction.
+         */
+        [[nodiscard]] inline uint64_t fingerprintKey(uint64_t key, size_t position) const {
+            if (COMPACTION_LEVEL < logk && position < (numKeys / k) * k) {
+                return compactKey(key);
             }
+            return key;
         }
 
-        template <size_t level>
-        void constructLevel(std::vector<uint64_t> &keys) {
+        /**
+         * Replace each key by a 32-bit hash. Keys of the same task must not collide, otherwise they can never
+         * be split. A collision happens in a task with probability about taskSize^2 / 2^33, so we try a new
+         * global seed until there is none. With the bound that startSearch checks, there are at most
+         * 2 collisions in expectation and an attempt succeeds with probability at least e^-2.
+         * 16-bit hashes would collide in practically every attempt.
+         */
+        std::vector<uint32_t> compactKeys(const std::vector<uint64_t> &keys) {
+            constexpr size_t taskSize = 1ul << (logk - COMPACTION_LEVEL);
+            constexpr size_t MAX_ATTEMPTS = 64;
+            std::vector<uint32_t> compactedKeys(keys.size());
+            std::array<uint32_t, taskSize> sortedTask;
+            for (compactionSeed = 0; compactionSeed < MAX_ATTEMPTS; compactionSeed++) {
+                bool collision = false;
+                for (size_t task = 0; task < keys.size() / taskSize && !collision; task++) {
+                    for (size_t i = 0; i < taskSize; i++) {
+                        compactedKeys[task * taskSize + i] = compactKey(keys[task * taskSize + i]);
+                        sortedTask[i] = compactedKeys[task * taskSize + i];
+                    }
+                    std::sort(sortedTask.begin(), sortedTask.end());
+                    collision = std::adjacent_find(sortedTask.begin(), sortedTask.end()) != sortedTask.end();
+                }
+                if (!collision) {
+                    return compactedKeys;
+                }
+            }
+            throw std::logic_error("Unable to compact keys without collisions, use a smaller compactionTaskSize");
+        }
+
+        /**
+         * After construction, the keys are partitioned such that each pair of keys is in its leaf task.
+         * Only the last level is not partitioned, so we only need to evaluate the last split.
+         */
+        template <typename Key>
+        void storeFingerprints(const std::vector<Key> &keys) {
+            for (size_t task = 0; task < keys.size() / 2; task++) {
+                uint64_t seed = leafSeed(task);
+                for (size_t i = 2 * task; i < 2 * task + 2; i++) {
+                    fingerprints.set(toLeft(keys[i], seed) ? 2 * task : 2 * task + 1, keys[i]);
+                }
+            }
+        }
+
+        [[nodiscard]] uint64_t leafSeed(size_t task) const {
+            if constexpr (SUBTREE_LEVEL < logk) {
+                constexpr size_t leavesPerSubtree = SUBTREE_SIZE / 2;
+                SubtreeTask subtreeTask(subtreeBudget.layout, SubtreeTask::logn - 1, task % leavesPerSubtree, task / leavesPerSubtree,
+                                        (numKeys / k) * (k / SUBTREE_SIZE));
+                return subtreeSeeds.readAt(subtreeTask.endPosition);
+            } else {
+                size_t seedEndPos = budget.layout.seedStartPosition(logk - 1, task + 1);
+                return unalignedBitVectors.at(logk - 1).readAt(seedEndPos);
+            }
+        }
+
+        /**
+         * Reads and checks the parameters. With RUNTIME_OVERHEAD, any overhead is accepted.
+         */
+        static Header readHeader(std::istream &is) {
+            if (readValue<uint64_t>(is) != MAGIC) {
+                throw std::invalid_argument("Not a serialized ConsensusRecSplit");
+            }
+            Header header;
+            if (readValue<uint64_t>(is) != k) {
+                throw std::invalid_argument("Serialized with different parameters");
+            }
+            header.serializedOverhead = readValue<double>(is);
+            if ((overhead != RUNTIME_OVERHEAD && header.serializedOverhead != overhead)
+                    || readValue<uint64_t>(is) != fingerprintBits || readValue<uint64_t>(is) != compactionTaskSize
+                    || readValue<uint64_t>(is) != subtreeTaskSize || readValue<uint64_t>(is) != SplitHash::ID) {
+                throw std::invalid_argument("Serialized with different parameters");
+            }
+            header.numKeys = readValue<uint64_t>(is);
+            return header;
+        }
+
+        /**
+         * Estimated fraction of the search work that is done when the levels before firstLevel are complete
+         * and the given fraction of the levels up to lastLevel (exclusive). Levels with small tasks take longer
+         * because of the per-task cost of the search. The weights are a rough fit of measured level times.
+         */
+        static double fractionDone(size_t firstLevel, size_t lastLevel, double fraction) {
+            double total = 0;
+            double done = 0;
+            for (size_t level = 0; level < logk; level++) {
+                double work = 1.0 + 64.0 / double(1ul << (logk - level));
+                total += work;
+                if (level < firstLevel) {
+                    done += work;
+                } else if (level < lastLevel) {
+                    done += fraction * work;
+                }
+            }
+            return done / total;
+        }
+
+        uint64_t checkpointIdentifier(std::span<const uint64_t> keys) const {
+            uint64_t identifier = bytehamster::util::remix(k + std::bit_cast<uint64_t>(getOverhead()) + keys.size()
+                                                           + (compactionTaskSize << 32) + (subtreeTaskSize << 48) + (SplitHash::ID << 60));
+            for (uint64_t key : keys) {
+                // Order does not matter because the levels only depend on the key sets of each task
+                identifier += bytehamster::util::remix(key);
+            }
+            return identifier;
+        }
+
+        void writeCheckpoint(std::ostream &os, SearchPosition position) const {
+            writeValue<uint64_t>(os, position.level);
+            writeValue<uint64_t>(os, position.task);
+            for (size_t level = 0; level <= position.level && level < SUBTREE_LEVEL; level++) {
+                unalignedBitVectors.at(level).writeToStream(os);
+            }
+            if (position.level == SUBTREE_LEVEL) {
+                writeValue<uint64_t>(os, position.subtreeLevel);
+                writeValue<uint64_t>(os, position.subtreeIndex);
+                subtreeSeeds.writeToStream(os);
+            }
+        }
+
+        SearchPosition readCheckpoint(std::istream &is) {
+            SearchPosition position;
+            position.level = readValue<uint64_t>(is);
+            position.task = readValue<uint64_t>(is);
+            if (position.level >= logk || position.level > SUBTREE_LEVEL) {
+                throw std::invalid_argument("Invalid checkpoint");
+            }
+            for (size_t level = 0; level <= position.level && level < SUBTREE_LEVEL; level++) {
+                unalignedBitVectors.at(level).readFromStream(is);
+            }
+            if (position.level == SUBTREE_LEVEL) {
+                position.subtreeLevel = readValue<uint64_t>(is);
+                position.subtreeIndex = readValue<uint64_t>(is);
+                subtreeSeeds.readFromStream(is);
+                if (position.task >= (numKeys / k) * (k / SUBTREE_SIZE) || position.subtreeLevel >= logk - SUBTREE_LEVEL
+                        || position.subtreeIndex >= (1ul << position.subtreeLevel)) {
+                    throw std::invalid_argument("Invalid checkpoint");
+                }
+            }
+            return position;
+        }
+
+        template <size_t level, typename Key>
+        void constructLevel(std::vector<Key> &keys, ConstructionMonitor &monitor,
+                            std::optional<SearchPosition> resumePosition) {
             constexpr size_t taskSize = 1ul << (logk - level);
 
             auto beginConstruction = std::chrono::high_resolution_clock::now();
-            findSeedsForLevel<level>(keys);
+            if (!resumePosition.has_value() || level > resumePosition->level) {
+                findSeedsForLevel<level>(keys, monitor, std::nullopt);
+            } else if (level == resumePosition->level) {
+                findSeedsForLevel<level>(keys, monitor, resumePosition->task);
+            } // Else: Seeds are already completely restored from the checkpoint, only repeat the partitioning
 
             if constexpr (taskSize > 2) {
                 assert(keys.size() % taskSize == 0);
                 size_t numTasks = keys.size() / taskSize;
                 for (size_t task = 0; task < numTasks; task++) {
-                    size_t seedEndPos = SplittingTreeStorageLevelwise<k, overhead>::seedStartPosition(level, task + 1);
+                    size_t seedEndPos = budget.layout.seedStartPosition(level, task + 1);
                     uint64_t seed = unalignedBitVectors.at(level).readAt(seedEndPos);
                     std::partition(keys.begin() + task * taskSize,
                                    keys.begin() + (task + 1) * taskSize,
-                                   [&](uint64_t key) { return toLeft(key, seed); });
+                                   [&, hashedSeed = SplitHash::hashSeed(seed)](Key key) { return SplitHash::toLeft(key, hashedSeed); });
                 }
             }
             unsigned long constructionDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
                     std::chrono::high_resolution_clock::now() - beginConstruction).count();
             size_t numTasks = keys.size() / taskSize;
-            size_t bitsThisLevel = SplittingTreeStorageLevelwise<k, overhead>::seedStartPosition(level, numTasks);
-            std::cout<<"Level "<<level<<" ("<<taskSize<<" keys each): "<<constructionDurationMs<<" ms, "
-                        <<(1000*constructionDurationMs/bitsThisLevel)<<" us per output bit"<<std::endl;
+            size_t bitsThisLevel = budget.layout.seedStartPosition(level, numTasks);
+            // The search reads all keys once, the partitioning reads and writes them again
+            size_t streamedBytes = (taskSize > 2 ? 3 : 1) * keys.size() * sizeof(Key);
+            if (!monitor.quiet()) {
+                std::cout<<"Level "<<level<<" ("<<taskSize<<" keys each): "<<constructionDurationMs<<" ms, "
+                            <<(1000*constructionDurationMs/bitsThisLevel)<<" us per output bit, "
+                            <<(streamedBytes / (1024 * 1024))<<" MiB memory traffic"<<std::endl;
+            }
+
+            constructFromLevel<level + 1>(keys, monitor, resumePosition);
+        }
 
-            if constexpr (level + 1 < logk) {
-                constructLevel<level + 1>(keys);
+        /**
+         * Constructs all levels from SUBTREE_LEVEL on, one subtree after the other.
+         * The subtrees are searched and stored like the buckets of ConsensusRecSplitQueryOptimized.
+         */
+        template <typename Key>
+        void constructSubtrees(std::vector<Key> &keys, ConstructionMonitor &monitor,
+                               std::optional<SearchPosition> resumePosition) {
+            auto beginConstruction = std::chrono::high_resolution_clock::now();
+            size_t numSubtrees = keys.size() / SUBTREE_SIZE;
+            if (!resumePosition.has_value() || resumePosition->level < SUBTREE_LEVEL) {
+                resumePosition = std::nullopt;
+                subtreeSeeds.clearAndResize(numSubtrees * subtreeBudget.layout.totalSize());
+            }
+            size_t firstRootSeed = resumePosition.has_value() ? subtreeSeeds.readRootSeed() : 0;
+            bool success = false;
+            for (size_t rootSeed = firstRootSeed; rootSeed < (1ul << 63) && !success; rootSeed++) {
+                subtreeSeeds.writeRootSeed(rootSeed);
+                success = searchSubtrees(std::span<Key>(keys), monitor, resumePosition);
+                resumePosition = std::nullopt;
+            }
+            if (!success) {
+                throw std::logic_error("Unable to construct");
+            }
+            unsigned long constructionDurationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::high_resolution_clock::now() - beginConstruction).count();
+            // Each subtree is read from memory and written back once, all other accesses hit the cache
+            size_t streamedBytes = 2 * keys.size() * sizeof(Key);
+            if (!monitor.quiet()) {
+                std::cout<<"Levels "<<SUBTREE_LEVEL<<" to "<<(logk - 1)<<" ("<<numSubtrees<<" subtrees of "<<SUBTREE_SIZE
+                            <<" keys each): "<<constructionDurationMs<<" ms, "
+                            <<(1000*constructionDurationMs/subtreeSeeds.bitSize())<<" us per output bit, "
+                            <<(streamedBytes / (1024 * 1024))<<" MiB memory traffic"<<std::endl;
+            }
+        }
+
+        /**
+         * Partition the keys of all subtree tasks before the resume position with their stored seeds,
+         * leading to the same key sets in each task as in the interrupted construction.
+         */
+        template <typename Key>
+        void replaySubtreePartitioning(std::span<Key> keys, SearchPosition resumePosition) {
+            SubtreeTask task(subtreeBudget.layout, 0, 0, 0, keys.size() / SUBTREE_SIZE);
+            while (task.bucket != resumePosition.task || task.level != resumePosition.subtreeLevel
+                        || task.index != resumePosition.subtreeIndex) {
+                if (task.taskSizeThisLevel > 2) {
+                    std::span<Key> keysThisTask = keys.subspan(
+                            task.bucket * SUBTREE_SIZE + task.index * task.taskSizeThisLevel, task.taskSizeThisLevel);
+                    uint64_t seed = subtreeSeeds.readAt(task.endPosition);
+                    std::partition(keysThisTask.begin(), keysThisTask.end(),
+                                   [&, hashedSeed = SplitHash::hashSeed(seed)](Key key) { return SplitHash::toLeft(key, hashedSeed); });
+                }
+                task.next();
+            }
+        }
+
+        template <typename Key>
+        void partitionSubtreeLevel(std::span<Key> keys, size_t subtree, size_t level) {
+            SubtreeTask task(subtreeBudget.layout, level, 0, subtree, keys.size() / SUBTREE_SIZE);
+            for (; task.index < task.tasksThisLevel; task.index++) {
+                task.updateProperties();
+                std::span<Key> keysThisTask = keys.subspan(
+                        subtree * SUBTREE_SIZE + task.index * task.taskSizeThisLevel, task.taskSizeThisLevel);
+                uint64_t seed = subtreeSeeds.readAt(task.endPosition);
+                std::partition(keysThisTask.begin(), keysThisTask.end(),
+                               [&, hashedSeed = SplitHash::hashSeed(seed)](Key key) { return SplitHash::toLeft(key, hashedSeed); });
+            }
+        }
+
+        /**
+         * Same backtracking as ConsensusRecSplitQueryOptimized::construct, with subtrees instead of buckets.
+         */
+        template <typename Key>
+        bool searchSubtrees(std::span<Key> keys, ConstructionMonitor &monitor,
+                            std::optional<SearchPosition> resumePosition) {
+            if (resumePosition.has_value()) {
+                replaySubtreePartitioning(keys, *resumePosition);
+            }
+            // When resuming, the seed of the current task was written to the checkpoint
+            SearchPosition start = resumePosition.value_or(SearchPosition());
+            SubtreeTask task(subtreeBudget.layout, start.subtreeLevel, start.subtreeIndex, start.task, keys.size() / SUBTREE_SIZE);
+            constexpr auto findSeedOnLevel = seedFinders<Key>(std::make_index_sequence<SubtreeTask::logn>());
+            uint64_t seed = subtreeSeeds.readAt(task.endPosition);
+            size_t attempts = 0;
+            while (true) {
+                if (++attempts % MONITOR_CHECK_INTERVAL == 0) [[unlikely]] {
+                    double fractionOfSubtrees = (double) task.bucket / task.nbuckets;
+                    monitor.poll(fractionDone(SUBTREE_LEVEL, logk, fractionOfSubtrees), [&](std::ostream &os) {
+                        subtreeSeeds.writeTo(task.endPosition, seed);
+                        writeCheckpoint(os, SearchPosition{ SUBTREE_LEVEL, task.bucket, task.level, task.index });
+                    });
+                }
+                std::span<Key> keysThisTask = keys.subspan(
+                        task.bucket * SUBTREE_SIZE + task.index * task.taskSizeThisLevel, task.taskSizeThisLevel);
+                bool success = (this->*findSeedOnLevel[task.level])(keysThisTask, seed, seed | task.seedMask);
+                if (success) {
+                    subtreeSeeds.writeTo(task.endPosition, seed);
+                    task.next();
+                    if (task.isEnd()) {
+                        return true;
+                    } else if (task.index == 0 && task.level > 0) {
+                        // Like the level-wise search, only partition once a level is complete. Backtracking mostly
+                        // stays within a level, so partitioning after each task would mostly be repeated work.
+                        partitionSubtreeLevel(keys, task.bucket, task.level - 1);
+                    }
+                    // Storage is contiguous in search order and the bits after the current task are still 0
+                    seed <<= task.seedWidth;
+                } else {
+                    seed--; // Was incremented beyond max seed, set back to max
+                    do {
+                        seed &= ~task.seedMask; // Reset seed to 0
+                        subtreeSeeds.writeTo(task.endPosition, seed);
+                        if (task.isFirst()) {
+                            return false; // Can't backtrack further, fail
+                        }
+                        task.previous();
+                        seed = subtreeSeeds.readAt(task.endPosition);
+                    } while ((seed & task.seedMask) == task.seedMask); // Backtrack all tasks that are at their max seed
+                    seed++; // Start backtracked task with its next seed candidate
+                }
             }
         }
 
-        template <size_t level>
-        void findSeedsForLevel(const std::vector<uint64_t> &keys) {
+        template <size_t level, typename Key>
+        void findSeedsForLevel(const std::vector<Key> &keys, ConstructionMonitor &monitor,
+                               std::optional<size_t> resumeTask) {
             static_assert(level < logk);
             constexpr size_t taskSize = 1ul << (logk - level);
             size_t numTasks = keys.size() / taskSize;
 
-            size_t bitsThisLevel = SplittingTreeStorageLevelwise<k, overhead>::seedStartPosition(level, numTasks);
+            size_t bitsThisLevel = budget.layout.seedStartPosition(level, numTasks);
             UnalignedBitVector &unalignedBitVector = unalignedBitVectors.at(level);
-            unalignedBitVector.clearAndResize(bitsThisLevel);
+            if (!resumeTask.has_value()) {
+                unalignedBitVector.clearAndResize(bitsThisLevel);
+            }
 
-            SplittingTaskIteratorLevelwise<k, overhead, level> task(0, unalignedBitVector);
+            // When resuming, the seed of the current task was written to the checkpoint
+            SplittingTaskIteratorLevelwise<k, level> task(budget.layout, resumeTask.value_or(0), unalignedBitVector);
+            size_t trials = 0;
             while (true) {
+                if (++trials % MONITOR_CHECK_INTERVAL == 0) [[unlikely]] {
+                    monitor.poll(fractionDone(level, level + 1, (double) task.idx / numTasks), [&](std::ostream &os) {
+                        task.writeSeed();
+                        writeCheckpoint(os, SearchPosition{ level, task.idx });
+                    });
+                }
                 if (isSeedSuccessful<taskSize>(keys, task.fromKey, task.seed)) {
                     task.writeSeed();
                     if (task.idx + 1 == numTasks) [[unlikely]] {
@@ -169,17 +717,39 @@ class ConsensusRecSplit {
             }
         }
 
-        template <size_t n>
-        bool isSeedSuccessful(const std::vector<uint64_t> &keys, size_t from, uint64_t seed) {
+        template <size_t n, typename Keys>
+        bool isSeedSuccessful(const Keys &keys, size_t from, uint64_t seed) {
+            uint64_t hashedSeed = SplitHash::hashSeed(seed);
             size_t numToLeft = 0;
             for (size_t i = 0; i < n; i++) {
-                numToLeft += toLeft(keys[from + i], seed);
+                numToLeft += SplitHash::toLeft(keys[from + i], hashedSeed);
             }
             return numToLeft == n / 2;
         }
 
+        /**
+         * Tries all seeds up to maxSeed and leaves the seed at the first successful one.
+         */
+        template <size_t n, typename Key>
+        bool findSeed(std::span<const Key> keys, uint64_t &seed, uint64_t maxSeed) {
+            for (; seed <= maxSeed; seed++) {
+                if (isSeedSuccessful<n>(keys, 0, seed)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * One findSeed per subtree level, so that the loop over the keys is unrolled for the small tasks.
+         */
+        template <typename Key, size_t... levels>
+        static constexpr auto seedFinders(std::index_sequence<levels...>) {
+            return std::array{ &ConsensusRecSplit::findSeed<(SUBTREE_SIZE >> levels), Key>... };
+        }
+
         [[nodiscard]] static bool toLeft(uint64_t key, uint64_t seed) {
-            return bytehamster::util::remix(key + seed) % 2;
+            return SplitHash::toLeft(key, SplitHash::hashSeed(seed));
         }
 };
 } // namespace consensus
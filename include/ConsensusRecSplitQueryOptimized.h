@@ -2,8 +2,12 @@
 
 #include <cstdint>
 #include <vector>
+#include <memory>
+#include <memory_resource>
 #include <fstream>
 #include <span>
+#include <optional>
+#include <bit>
 
 #include <ips2ra.hpp>
 #include <bytehamster/util/MurmurHash64.h>
@@ -12,6 +16,9 @@
 #include "consensus/UnalignedBitVector.h"
 #include "consensus/SplittingTreeStorageQueryOptimized.h"
 #include "consensus/BumpedKPerfectHashFunction.h"
+#include "consensus/FingerprintArray.h"
+#include "consensus/ConstructionOptions.h"
+#include "consensus/SplitHash.h"
 
 namespace consensus {
 
@@ -19,40 +26,160 @@ namespace consensus {
  * Perfect hash function using the consensus idea: Combined search and encoding of successful seeds.
  * <code>k</code> is the size of each RecSplit base case and must be a power of 2.
  * Optimized for faster queries by constructing bucket-by-bucket instead of layer-by-layer.
+ * With <code>fingerprintBits</code> > 0, a fingerprint of each key is stored at its output position,
+ * so that <code>contains</code> can reject keys outside the input set with false positive rate 2^-fingerprintBits.
+ * <code>SplitHash</code> is the function that splits the keys of a task, see SplitHash.h.
+ * With <code>overhead</code> = RUNTIME_OVERHEAD, the overhead is a constructor argument instead.
  */
-template <size_t k, double overhead>
+template <size_t k, double overhead, size_t fingerprintBits = 0, typename SplitHash = RemixSplitHash>
 class ConsensusRecSplitQueryOptimized {
     public:
         static_assert(1ul << intLog2(k) == k, "k must be a power of 2");
-        static_assert(overhead > 0);
+        static_assert(overhead > 0 || overhead == RUNTIME_OVERHEAD);
         static constexpr size_t logk = intLog2(k);
+        static constexpr uint64_t MAGIC = 0x54504f5153524e43; // Start of serialized instances, "CNRSQOPT"
+        // Only takes space with RUNTIME_OVERHEAD
+        [[no_unique_address]] OverheadBudget<QueryOptimizedLayout<k>, overhead> budget;
         size_t numKeys = 0;
         UnalignedBitVector unalignedBitVector;
-        BumpedKPerfectHashFunction<k> *bucketingPhf = nullptr;
+        std::unique_ptr<BumpedKPerfectHashFunction<k>> bucketingPhf;
+        FingerprintArray<fingerprintBits> fingerprints;
 
-        explicit ConsensusRecSplitQueryOptimized(std::span<const std::string> keys)
-                : numKeys(keys.size()),
-                  unalignedBitVector((numKeys / k) * SplittingTreeStorageQueryOptimized<k, overhead>::totalSize()) {
+        explicit ConsensusRecSplitQueryOptimized(std::span<const std::string> keys) requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplitQueryOptimized(keys, ConstructionOptions()) {
+        }
+
+        explicit ConsensusRecSplitQueryOptimized(std::span<const uint64_t> keys) requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplitQueryOptimized(keys, ConstructionOptions()) {
+        }
+
+        /**
+         * Construct while periodically writing the seeds and the current search position to a file.
+         * If the checkpoint file already exists, the construction resumes from there.
+         * The file is deleted after a successful construction.
+         */
+        ConsensusRecSplitQueryOptimized(std::span<const std::string> keys, const CheckpointConfig &checkpointConfig)
+                requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplitQueryOptimized(keys, ConstructionOptions{ .checkpoint = checkpointConfig }) {
+        }
+
+        ConsensusRecSplitQueryOptimized(std::span<const uint64_t> keys, const CheckpointConfig &checkpointConfig)
+                requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplitQueryOptimized(keys, ConstructionOptions{ .checkpoint = checkpointConfig }) {
+        }
+
+        /**
+         * Construct with cancellation, a deadline, progress reports and checkpoints, see ConstructionOptions.
+         * Throws ConstructionInterrupted if the construction is stopped, which also ends the search over root seeds.
+         */
+        ConsensusRecSplitQueryOptimized(std::span<const std::string> keys, const ConstructionOptions &options)
+                requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplitQueryOptimized(keys, overhead, options) {
+        }
+
+        ConsensusRecSplitQueryOptimized(std::span<const uint64_t> keys, const ConstructionOptions &options)
+                requires (overhead != RUNTIME_OVERHEAD)
+                : ConsensusRecSplitQueryOptimized(keys, overhead, options) {
+        }
+
+        /**
+         * Construct with an overhead that is only known at runtime, see RUNTIME_OVERHEAD.
+         * With a compile-time overhead, the argument must be equal to it.
+         */
+        ConsensusRecSplitQueryOptimized(std::span<const std::string> keys, double runtimeOverhead,
+                                        const ConstructionOptions &options = ConstructionOptions())
+                : budget(runtimeOverhead), numKeys(keys.size()),
+                  unalignedBitVector((numKeys / k) * budget.layout.totalSize()),
+                  fingerprints(numKeys) {
             std::vector<uint64_t> hashedKeys;
             hashedKeys.reserve(keys.size());
             for (const std::string &key : keys) {
                 hashedKeys.push_back(bytehamster::util::MurmurHash64(key));
             }
-            startSearch(hashedKeys);
+            ConstructionMonitor monitor(options, [&] { return checkpointIdentifier(hashedKeys); });
+            startSearch(hashedKeys, monitor);
+            monitor.finish();
+        }
+
+        ConsensusRecSplitQueryOptimized(std::span<const uint64_t> keys, double runtimeOverhead,
+                                        const ConstructionOptions &options = ConstructionOptions())
+                : budget(runtimeOverhead), numKeys(keys.size()),
+                  unalignedBitVector((numKeys / k) * budget.layout.totalSize()),
+                  fingerprints(numKeys) {
+            ConstructionMonitor monitor(options, [&] { return checkpointIdentifier(keys); });
+            startSearch(keys, monitor);
+            monitor.finish();
+        }
+
+        /**
+         * Construct with a bucketing function that was already built on the same keys,
+         * for example while choosing k, so that it is not built again.
+         */
+        ConsensusRecSplitQueryOptimized(std::span<const uint64_t> keys,
+                                        std::unique_ptr<BumpedKPerfectHashFunction<k>> bucketing,
+                                        double runtimeOverhead, const ConstructionOptions &options = ConstructionOptions())
+                : budget(runtimeOverhead), numKeys(keys.size()),
+                  unalignedBitVector((numKeys / k) * budget.layout.totalSize()),
+                  bucketingPhf(std::move(bucketing)), fingerprints(numKeys) {
+            if (bucketingPhf == nullptr || bucketingPhf->getN() != numKeys) {
+                throw std::invalid_argument("Bucketing function was not built on these keys");
+            }
+            ConstructionMonitor monitor(options, [&] { return checkpointIdentifier(keys); });
+            startSearch(keys, monitor);
+            monitor.finish();
+        }
+
+        /**
+         * Load an instance that was written using writeToStream.
+         */
+        explicit ConsensusRecSplitQueryOptimized(std::istream &is)
+                : ConsensusRecSplitQueryOptimized(is, readHeader(is)) {
+        }
+
+        struct Header {
+            double serializedOverhead;
+            size_t numKeys;
+        };
+
+        /**
+         * Reads and checks the parameters of a serialized instance, without loading it.
+         * With RUNTIME_OVERHEAD, any overhead is accepted.
+         */
+        static Header readHeader(std::istream &is) {
+            if (readValue<uint64_t>(is) != MAGIC) {
+                throw std::invalid_argument("Not a serialized ConsensusRecSplitQueryOptimized");
+            }
+            Header header;
+            if (readValue<uint64_t>(is) != k) {
+                throw std::invalid_argument("Serialized with different parameters");
+            }
+            header.serializedOverhead = readValue<double>(is);
+            if ((overhead != RUNTIME_OVERHEAD && header.serializedOverhead != overhead)
+                    || readValue<uint64_t>(is) != fingerprintBits || readValue<uint64_t>(is) != SplitHash::ID) {
+                throw std::invalid_argument("Serialized with different parameters");
+            }
+            header.numKeys = readValue<uint64_t>(is);
+            return header;
         }
 
-        explicit ConsensusRecSplitQueryOptimized(std::span<const uint64_t> keys)
-                : numKeys(keys.size()),
-                  unalignedBitVector((numKeys / k) * SplittingTreeStorageQueryOptimized<k, overhead>::totalSize()) {
-            startSearch(keys);
+    private:
+        ConsensusRecSplitQueryOptimized(std::istream &is, Header header)
+                : budget(header.serializedOverhead), numKeys(header.numKeys), fingerprints(numKeys) {
+            unalignedBitVector.readFromStream(is);
+            if (unalignedBitVector.bitSize() != UnalignedBitVector((numKeys / k) * budget.layout.totalSize()).bitSize()) {
+                throw std::invalid_argument("Invalid seed vector size");
+            }
+            bucketingPhf = std::make_unique<BumpedKPerfectHashFunction<k>>(is);
+            fingerprints.readFromStream(is);
         }
 
-        ~ConsensusRecSplitQueryOptimized() {
-            delete bucketingPhf;
+    public:
+        [[nodiscard]] double getOverhead() const {
+            return budget.getOverhead();
         }
 
         [[nodiscard]] size_t getBits() const {
-            return unalignedBitVector.bitSize() + bucketingPhf->getBits();
+            return unalignedBitVector.bitSize() + bucketingPhf->getBits() + fingerprints.getBits();
         }
 
         [[nodiscard]] size_t operator()(const std::string &key) const {
@@ -60,34 +187,118 @@ class ConsensusRecSplitQueryOptimized {
         }
 
         [[nodiscard]] size_t operator()(uint64_t key) const {
-            size_t nbuckets = numKeys / k;
-            size_t bucket = bucketingPhf->operator()(key);
-            if (bucket >= nbuckets) {
-                return bucket; // Fallback if numKeys does not divide n
-            }
-            SplittingTaskIteratorQueryOptimized<k, overhead> task(0, 0, bucket, numKeys / k);
-            for (size_t level = 0; level < logk; level++) {
-                task.setLevel(level);
-                if (toLeft(key, readSeed(task))) {
-                    task.index = 2 * task.index;
-                } else {
-                    task.index = 2 * task.index + 1;
+            return evaluateSplittingTree(budget.layout, key, bucketingPhf->operator()(key), numKeys / k,
+                                         unalignedBitVector.words());
+        }
+
+        /**
+         * Evaluate a function that was exported to plain arrays, see <code>tools/code_generator.cpp</code>.
+         * With the arrays being constexpr, the compiler can evaluate the tree layout at compile time.
+         */
+        [[nodiscard]] static inline size_t queryArrays(uint64_t key, size_t numKeys, std::span<const uint64_t> seeds,
+                std::span<const uint32_t> thresholds,
+                std::span<const typename BumpedKPerfectHashFunction<k>::LayerInfo> layers,
+                std::span<const uint64_t> fallbackHashes, std::span<const uint64_t> fallbackResults)
+                requires (overhead != RUNTIME_OVERHEAD) {
+            return queryArrays(decltype(budget)::layout, key, numKeys, seeds,
+                               thresholds, layers, fallbackHashes, fallbackResults);
+        }
+
+        /**
+         * Evaluate exported arrays with a layout that is computed at runtime, for example with RUNTIME_OVERHEAD.
+         * The thresholds can also be given as a view of packed storage, see BumpedKPerfectHashFunction::queryArrays.
+         */
+        template <typename Thresholds>
+        [[nodiscard]] static inline size_t queryArrays(const QueryOptimizedLayout<k> &layout, uint64_t key,
+                size_t numKeys, std::span<const uint64_t> seeds, const Thresholds &thresholds,
+                std::span<const typename BumpedKPerfectHashFunction<k>::LayerInfo> layers,
+                std::span<const uint64_t> fallbackHashes, std::span<const uint64_t> fallbackResults) {
+            size_t bucket = BumpedKPerfectHashFunction<k>::queryArrays(
+                    key, thresholds, layers, fallbackHashes, fallbackResults);
+            return evaluateSplittingTree(layout, key, bucket, numKeys / k, seeds);
+        }
+
+        /**
+         * Returns false if the key is definitely not part of the input set.
+         * Keys outside the input set return true with probability 2^-fingerprintBits.
+         */
+        [[nodiscard]] bool contains(const std::string &key) const requires (fingerprintBits > 0) {
+            return contains(bytehamster::util::MurmurHash64(key));
+        }
+
+        [[nodiscard]] bool contains(uint64_t key) const requires (fingerprintBits > 0) {
+            return fingerprints.matches(this->operator()(key), key);
+        }
+
+        /**
+         * Batched membership check. Evaluates the hash function for a chunk of keys before
+         * comparing fingerprints, so that the independent memory accesses can overlap.
+         */
+        void contains(std::span<const uint64_t> keys, std::span<bool> result) const requires (fingerprintBits > 0) {
+            assert(result.size() >= keys.size());
+            constexpr size_t CHUNK = 64;
+            std::array<size_t, CHUNK> positions;
+            for (size_t chunkStart = 0; chunkStart < keys.size(); chunkStart += CHUNK) {
+                size_t chunkSize = std::min(CHUNK, keys.size() - chunkStart);
+                for (size_t i = 0; i < chunkSize; i++) {
+                    positions[i] = this->operator()(keys[chunkStart + i]);
+                }
+                for (size_t i = 0; i < chunkSize; i++) {
+                    result[chunkStart + i] = fingerprints.matches(positions[i], keys[chunkStart + i]);
                 }
             }
-            return bucket * k + task.index;
+        }
+
+        /**
+         * Serialize this instance.
+         */
+        void writeToStream(std::ostream &os) const {
+            writeValue(os, MAGIC);
+            writeValue<uint64_t>(os, k);
+            writeValue<double>(os, budget.getOverhead());
+            writeValue<uint64_t>(os, fingerprintBits);
+            writeValue<uint64_t>(os, SplitHash::ID);
+            writeValue<uint64_t>(os, numKeys);
+            unalignedBitVector.writeToStream(os);
+            bucketingPhf->writeToStream(os);
+            fingerprints.writeToStream(os);
         }
 
     private:
-        void startSearch(std::span<const uint64_t> keys) {
-            std::cout << "Tree space per bucket: " << SplittingTreeStorageQueryOptimized<k, overhead>::totalSize() << std::endl;
+        static constexpr size_t MONITOR_CHECK_INTERVAL = 1ul << 10; // Task attempts between polling the monitor
+
+        struct SearchPosition {
+            size_t bucket = 0;
+            size_t level = 0;
+            size_t index = 0;
+        };
+
+        void startSearch(std::span<const uint64_t> keys, ConstructionMonitor &monitor) {
+            if (!monitor.quiet()) {
+                std::cout << "Tree space per bucket: " << budget.layout.totalSize() << std::endl;
+            }
 
-            bucketingPhf = new BumpedKPerfectHashFunction<k>(keys);
+            std::optional<SearchPosition> resumePosition;
+            if (std::optional<std::ifstream> is = monitor.openCheckpoint()) {
+                resumePosition = readCheckpoint(*is);
+                if (!monitor.quiet()) {
+                    std::cout << "Resuming from bucket " << resumePosition->bucket << std::endl;
+                }
+            }
+
+            // Deterministic, so we do not need to store it in the checkpoint.
+            // Not overlapped with the search: it processes the seeds of all buckets as one chain, in bucket order,
+            // and the first layer already leaves some of the first buckets waiting for bumped keys.
+            if (bucketingPhf == nullptr) {
+                bucketingPhf = std::make_unique<BumpedKPerfectHashFunction<k>>(keys, monitor.scratch());
+            }
             size_t nbuckets = keys.size() / k;
-            std::vector<size_t> counters(nbuckets);
-            std::vector<uint64_t> modifiableKeys(nbuckets * k); // Note that this is possibly fewer than n
+            std::pmr::vector<size_t> counters(nbuckets, monitor.scratch());
+            std::pmr::vector<uint64_t> modifiableKeys(nbuckets * k, monitor.scratch()); // Possibly fewer than n
             for (uint64_t key : keys) {
                 size_t bucket = bucketingPhf->operator()(key);
                 if (bucket >= nbuckets) {
+                    fingerprints.set(bucket, key);
                     continue; // No need to handle this key
                 }
                 modifiableKeys.at(bucket * k + counters.at(bucket)) = key;
@@ -99,19 +310,91 @@ class ConsensusRecSplitQueryOptimized {
                 }
             #endif
 
-            for (size_t rootSeed = 0; rootSeed < (1ul << 63); rootSeed++) {
+            if (modifiableKeys.empty()) {
+                return; // Fewer than k keys, all handled by the bucketing function
+            }
+            size_t firstRootSeed = resumePosition.has_value() ? unalignedBitVector.readRootSeed() : 0;
+            for (size_t rootSeed = firstRootSeed; rootSeed < (1ul << 63); rootSeed++) {
                 unalignedBitVector.writeRootSeed(rootSeed);
-                if (construct(modifiableKeys)) {
+                bool success = construct(modifiableKeys, monitor, resumePosition);
+                resumePosition = std::nullopt;
+                if (success) {
+                    if constexpr (fingerprintBits > 0) {
+                        storeFingerprints(modifiableKeys);
+                    }
                     return;
                 }
             }
             throw std::logic_error("Unable to construct");
         }
 
-        bool construct(std::span<uint64_t> keys) {
-            SplittingTaskIteratorQueryOptimized<k, overhead> task(0, 0, 0, numKeys / k);
+        uint64_t checkpointIdentifier(std::span<const uint64_t> keys) const {
+            uint64_t identifier = bytehamster::util::remix(k + std::bit_cast<uint64_t>(getOverhead()) + keys.size() + 1
+                                                           + (SplitHash::ID << 60));
+            for (uint64_t key : keys) {
+                // Order does not matter because the search only depends on the key sets of each task
+                identifier += bytehamster::util::remix(key);
+            }
+            return identifier;
+        }
+
+        void writeCheckpoint(std::ostream &os, SearchPosition position) const {
+            writeValue<uint64_t>(os, position.bucket);
+            writeValue<uint64_t>(os, position.level);
+            writeValue<uint64_t>(os, position.index);
+            unalignedBitVector.writeToStream(os);
+        }
+
+        SearchPosition readCheckpoint(std::istream &is) {
+            SearchPosition position;
+            position.bucket = readValue<uint64_t>(is);
+            position.level = readValue<uint64_t>(is);
+            position.index = readValue<uint64_t>(is);
+            unalignedBitVector.readFromStream(is);
+            if (position.bucket >= numKeys / k || position.level >= logk || position.index >= (1ul << position.level)
+                    || unalignedBitVector.bitSize() != UnalignedBitVector(
+                            (numKeys / k) * budget.layout.totalSize()).bitSize()) {
+                throw std::invalid_argument("Invalid checkpoint");
+            }
+            return position;
+        }
+
+        /**
+         * Partition the keys of all tasks before the resume position with their stored seeds,
+         * leading to the same key sets in each task as in the interrupted construction.
+         */
+        void replayPartitioning(std::span<uint64_t> keys, SearchPosition resumePosition) {
+            SplittingTaskIteratorQueryOptimized<k> task(budget.layout, 0, 0, 0, numKeys / k);
+            while (task.bucket != resumePosition.bucket || task.level != resumePosition.level
+                        || task.index != resumePosition.index) {
+                if (task.taskSizeThisLevel > 2) {
+                    size_t keysBegin = task.bucket * k + task.index * task.taskSizeThisLevel;
+                    std::span<uint64_t> keysThisTask = keys.subspan(keysBegin, task.taskSizeThisLevel);
+                    uint64_t seed = readSeed(task);
+                    std::partition(keysThisTask.begin(), keysThisTask.end(),
+                                   [&, hashedSeed = SplitHash::hashSeed(seed)](uint64_t key) { return SplitHash::toLeft(key, hashedSeed); });
+                }
+                task.next();
+            }
+        }
+
+        bool construct(std::span<uint64_t> keys, ConstructionMonitor &monitor,
+                       std::optional<SearchPosition> resumePosition) {
+            if (resumePosition.has_value()) {
+                replayPartitioning(keys, *resumePosition);
+            }
+            // When resuming, the seed of the current task was written to the checkpoint
+            SearchPosition start = resumePosition.value_or(SearchPosition());
+            SplittingTaskIteratorQueryOptimized<k> task(budget.layout, start.level, start.index, start.bucket, numKeys / k);
             uint64_t seed = readSeed(task);
+            size_t attempts = 0;
             while (true) { // Basically "while (!task.isEnd())"
+                if (++attempts % MONITOR_CHECK_INTERVAL == 0) [[unlikely]] {
+                    monitor.poll((double) task.bucket / task.nbuckets, [&](std::ostream &os) {
+                        writeSeed(task, seed);
+                        writeCheckpoint(os, SearchPosition{ task.bucket, task.level, task.index });
+                    });
+                }
                 size_t keysBegin = task.bucket * k + task.index * task.taskSizeThisLevel;
                 std::span<uint64_t> keysThisTask = keys.subspan(keysBegin, task.taskSizeThisLevel);
                 bool success = false;
@@ -125,7 +408,7 @@ class ConsensusRecSplitQueryOptimized {
                 if (success) {
                     if (task.taskSizeThisLevel > 2) { // No need to partition last layer
                         std::partition(keysThisTask.begin(), keysThisTask.end(),
-                                       [&](uint64_t key) { return toLeft(key, seed); });
+                                       [&, hashedSeed = SplitHash::hashSeed(seed)](uint64_t key) { return SplitHash::toLeft(key, hashedSeed); });
                     }
                     writeSeed(task, seed);
                     task.next();
@@ -150,23 +433,60 @@ class ConsensusRecSplitQueryOptimized {
             throw std::logic_error("Should never arrive here, function returns from within the loop");
         }
 
+        /**
+         * After construction, the keys are partitioned such that each pair of keys is in its leaf task.
+         * Only the last level is not partitioned, so we only need to evaluate the last split.
+         */
+        void storeFingerprints(std::span<const uint64_t> keys) {
+            size_t nbuckets = numKeys / k;
+            for (size_t bucket = 0; bucket < nbuckets; bucket++) {
+                SplittingTaskIteratorQueryOptimized<k> task(budget.layout, logk - 1, 0, bucket, nbuckets);
+                for (; task.index < k / 2; task.index++) {
+                    task.updateProperties();
+                    uint64_t seed = readSeed(task);
+                    size_t leafBegin = bucket * k + 2 * task.index;
+                    for (size_t i = leafBegin; i < leafBegin + 2; i++) {
+                        fingerprints.set(toLeft(keys[i], seed) ? leafBegin : leafBegin + 1, keys[i]);
+                    }
+                }
+            }
+        }
+
+        [[nodiscard]] static inline size_t evaluateSplittingTree(const QueryOptimizedLayout<k> &layout, uint64_t key,
+                size_t bucket, size_t nbuckets, std::span<const uint64_t> seeds) {
+            if (bucket >= nbuckets) {
+                return bucket; // Fallback if numKeys does not divide n
+            }
+            SplittingTaskIteratorQueryOptimized<k> task(layout, 0, 0, bucket, nbuckets);
+            for (size_t level = 0; level < logk; level++) {
+                task.setLevel(level);
+                if (toLeft(key, UnalignedBitVector::readAt(seeds, task.endPosition))) {
+                    task.index = 2 * task.index;
+                } else {
+                    task.index = 2 * task.index + 1;
+                }
+            }
+            return bucket * k + task.index;
+        }
+
         bool isSeedSuccessful(std::span<uint64_t> keys, uint64_t seed) {
+            uint64_t hashedSeed = SplitHash::hashSeed(seed);
             size_t numToLeft = 0;
             for (uint64_t key : keys) {
-                numToLeft += toLeft(key, seed);
+                numToLeft += SplitHash::toLeft(key, hashedSeed);
             }
             return numToLeft == (keys.size() / 2);
         }
 
         [[nodiscard]] static bool toLeft(uint64_t key, uint64_t seed) {
-            return bytehamster::util::remix(key + seed) % 2;
+            return SplitHash::toLeft(key, SplitHash::hashSeed(seed));
         }
 
-        [[nodiscard]] uint64_t readSeed(SplittingTaskIteratorQueryOptimized<k, overhead> task) const {
+        [[nodiscard]] uint64_t readSeed(SplittingTaskIteratorQueryOptimized<k> task) const {
             return unalignedBitVector.readAt(task.endPosition);
         }
 
-        void writeSeed(SplittingTaskIteratorQueryOptimized<k, overhead> task, uint64_t seed) {
+        void writeSeed(SplittingTaskIteratorQueryOptimized<k> task, uint64_t seed) {
             unalignedBitVector.writeTo(task.endPosition, seed);
         }
 };
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <istream>
+#include <span>
+#include <string>
+#include <stdexcept>
+#include <utility>
+
+#include <bytehamster/util/MurmurHash64.h>
+
+#include "ConsensusRecSplit.h"
+#include "ConsensusRecSplitQueryOptimized.h"
+#include "consensus/Serialization.h"
+
+namespace consensus {
+/**
+ * Perfect hash function with k, overhead and the variant chosen at runtime.
+ * Each supported k has one compile-time specialized kernel per variant,
+ * instantiated with RUNTIME_OVERHEAD, so the overhead does not multiply the number of instantiations.
+ * Queries cost one additional indirect call, which the batched query amortizes.
+ */
+class DynamicConsensusRecSplit {
+    public:
+        static constexpr size_t MIN_K = 32;
+        static constexpr size_t MAX_K = 32768;
+
+        enum class Variant { Levelwise, QueryOptimized };
+
+        struct Parameters {
+            size_t k = 8192;
+            double overhead = 0.01;
+            Variant variant = Variant::Levelwise;
+        };
+    private:
+        struct Kernel {
+            virtual ~Kernel() = default;
+            [[nodiscard]] virtual size_t operator()(uint64_t key) const = 0;
+            virtual void operator()(std::span<const uint64_t> keys, std::span<size_t> result) const = 0;
+            [[nodiscard]] virtual size_t getBits() const = 0;
+            [[nodiscard]] virtual size_t numKeys() const = 0;
+            [[nodiscard]] virtual double getOverhead() const = 0;
+            virtual void writeToStream(std::ostream &os) const = 0;
+        };
+
+        template <typename Phf>
+        struct KernelImpl final : Kernel {
+            Phf phf;
+
+            template <typename... Args>
+            explicit KernelImpl(Args &&...args) : phf(std::forward<Args>(args)...) {
+            }
+
+            [[nodiscard]] size_t operator()(uint64_t key) const override {
+                return phf(key);
+            }
+
+            void operator()(std::span<const uint64_t> keys, std::span<size_t> result) const override {
+                for (size_t i = 0; i < keys.size(); i++) {
+                    result[i] = phf(keys[i]);
+                }
+            }
+
+            [[nodiscard]] size_t getBits() const override {
+                return phf.getBits();
+            }
+
+            [[nodiscard]] size_t numKeys() const override {
+                return phf.numKeys;
+            }
+
+            [[nodiscard]] double getOverhead() const override {
+                return phf.getOverhead();
+            }
+
+            void writeToStream(std::ostream &os) const override {
+                phf.writeToStream(os);
+            }
+        };
+
+        template <size_t k>
+        using LevelwiseKernel = KernelImpl<ConsensusRecSplit<k, RUNTIME_OVERHEAD>>;
+        template <size_t k>
+        using QueryOptimizedKernel = KernelImpl<ConsensusRecSplitQueryOptimized<k, RUNTIME_OVERHEAD>>;
+
+        Parameters parameters;
+        std::unique_ptr<Kernel> kernel;
+    public:
+        DynamicConsensusRecSplit(std::span<const uint64_t> keys, Parameters parameters,
+                                 const ConstructionOptions &options = ConstructionOptions())
+                : parameters(parameters) {
+            kernel = dispatch(parameters, [&]<typename KernelType>() {
+                return std::make_unique<KernelType>(keys, parameters.overhead, options);
+            });
+        }
+
+        DynamicConsensusRecSplit(std::span<const std::string> keys, Parameters parameters,
+                                 const ConstructionOptions &options = ConstructionOptions())
+                : DynamicConsensusRecSplit(hashKeys(keys), parameters, options) {
+        }
+
+        /**
+         * Load an instance that was written using writeToStream or by the templated classes
+         * with the default parameters and any k and overhead.
+         * The stream must be seekable because the kernel reads the header again.
+         */
+        explicit DynamicConsensusRecSplit(std::istream &is) {
+            std::istream::pos_type begin = is.tellg();
+            uint64_t magic = readValue<uint64_t>(is);
+            parameters.k = readValue<uint64_t>(is);
+            if (magic == ConsensusRecSplit<MIN_K, RUNTIME_OVERHEAD>::MAGIC) {
+                parameters.variant = Variant::Levelwise;
+            } else if (magic == ConsensusRecSplitQueryOptimized<MIN_K, RUNTIME_OVERHEAD>::MAGIC) {
+                parameters.variant = Variant::QueryOptimized;
+            } else {
+                throw std::invalid_argument("Not a serialized ConsensusRecSplit or ConsensusRecSplitQueryOptimized");
+            }
+            if (!is.seekg(begin)) {
+                throw std::invalid_argument("Stream is not seekable");
+            }
+            kernel = dispatch(parameters, [&]<typename KernelType>() {
+                return std::make_unique<KernelType>(is);
+            });
+            parameters.overhead = kernel->getOverhead();
+        }
+
+        [[nodiscard]] const Parameters &getParameters() const {
+            return parameters;
+        }
+
+        [[nodiscard]] size_t getNumKeys() const {
+            return kernel->numKeys();
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return kernel->getBits();
+        }
+
+        [[nodiscard]] size_t operator()(const std::string &key) const {
+            return kernel->operator()(bytehamster::util::MurmurHash64(key));
+        }
+
+        [[nodiscard]] size_t operator()(uint64_t key) const {
+            return kernel->operator()(key);
+        }
+
+        /**
+         * Evaluates all keys with a single indirect call.
+         */
+        void operator()(std::span<const uint64_t> keys, std::span<size_t> result) const {
+            if (result.size() < keys.size()) {
+                throw std::invalid_argument("Result is smaller than the number of keys");
+            }
+            kernel->operator()(keys, result);
+        }
+
+        /**
+         * Serialize in the format of the templated class of the variant,
+         * so it can also be loaded with compile-time parameters.
+         */
+        void writeToStream(std::ostream &os) const {
+            kernel->writeToStream(os);
+        }
+
+    private:
+        static std::vector<uint64_t> hashKeys(std::span<const std::string> keys) {
+            std::vector<uint64_t> hashedKeys;
+            hashedKeys.reserve(keys.size());
+            for (const std::string &key : keys) {
+                hashedKeys.push_back(bytehamster::util::MurmurHash64(key));
+            }
+            return hashedKeys;
+        }
+
+        template <size_t k = MAX_K, typename Make>
+        static std::unique_ptr<Kernel> dispatch(const Parameters &parameters, Make make) {
+            if constexpr (k < MIN_K) {
+                throw std::invalid_argument("k must be a power of 2 between " + std::to_string(MIN_K)
+                                            + " and " + std::to_string(MAX_K));
+            } else if (parameters.k == k) {
+                if (parameters.variant == Variant::QueryOptimized) {
+                    return make.template operator()<QueryOptimizedKernel<k>>();
+                }
+                return make.template operator()<LevelwiseKernel<k>>();
+            } else {
+                return dispatch<k / 2>(parameters, make);
+            }
+        }
+};
+} // namespace consensus
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <filesystem>
+#include <span>
+#include <sstream>
+
+#include <bytehamster/util/MurmurHash64.h>
+#include <bytehamster/util/Function.h>
+
+#include "ConsensusRecSplitQueryOptimized.h"
+#include "consensus/Serialization.h"
+
+namespace consensus {
+/**
+ * Perfect hash function that is split into independent shards by a hash of the key.
+ * This makes it possible to construct the shards in different processes or on different machines.
+ * Each worker writes a shard file, and the shard files are merged into one file with a global offset table.
+ * A query adds the number of keys in all previous shards to the result of its shard.
+ * With <code>overhead</code> = RUNTIME_OVERHEAD, the overhead of the shards is chosen when constructing them.
+ * See <code>tools/sharded_construction.cpp</code> for a command line tool to coordinate the steps.
+ */
+template <size_t k, double overhead>
+class ShardedConsensusRecSplit {
+    public:
+        using Shard = ConsensusRecSplitQueryOptimized<k, overhead>;
+    private:
+        static constexpr uint64_t MAGIC_SHARD = 0x4452485353524e43; // "CNRSSHRD"
+        static constexpr uint64_t MAGIC_MERGED = 0x4447524d53524e43; // "CNRSMRGD"
+        static constexpr uint64_t SHARD_SEED = 0x2545f4914f6cdd1dul;
+        std::vector<uint64_t> offsets;
+        std::vector<std::unique_ptr<Shard>> shards;
+    public:
+        /**
+         * Load a file that was written using <code>merge</code>.
+         */
+        explicit ShardedConsensusRecSplit(std::istream &is) {
+            if (readValue<uint64_t>(is) != MAGIC_MERGED) {
+                throw std::invalid_argument("Not a merged ShardedConsensusRecSplit");
+            }
+            offsets = readVector<uint64_t>(is);
+            if (offsets.empty()) {
+                throw std::invalid_argument("Invalid offset table");
+            }
+            for (size_t i = 0; i + 1 < offsets.size(); i++) {
+                shards.push_back(std::make_unique<Shard>(is));
+                if (shards.back()->numKeys != offsets.at(i + 1) - offsets.at(i)) {
+                    throw std::invalid_argument("Shard size does not match the offset table");
+                }
+            }
+        }
+
+        /**
+         * Shard of a key. Uses a different hash than the bucketing inside the shards,
+         * which needs the keys of each shard to be uniformly distributed.
+         */
+        [[nodiscard]] static size_t shardOf(uint64_t key, size_t numShards) {
+            return bytehamster::util::fastrange64(bytehamster::util::remix(key + SHARD_SEED), numShards);
+        }
+
+        /**
+         * Construct the hash function of a single shard and write it to a shard file.
+         * All keys must belong to the given shard.
+         * The shard file starts with a header of the shard index, the number of shards and keys, and the serialized size.
+         */
+        static void constructShard(std::ostream &os, size_t shardIndex, size_t numShards,
+                                   std::span<const uint64_t> keys, double runtimeOverhead = overhead) {
+            for (uint64_t key : keys) {
+                if (shardOf(key, numShards) != shardIndex) {
+                    throw std::invalid_argument("Key does not belong to shard " + std::to_string(shardIndex));
+                }
+            }
+            Shard shard(keys, runtimeOverhead);
+            std::ostringstream serialized;
+            shard.writeToStream(serialized);
+            std::string blob = std::move(serialized).str();
+            writeValue(os, MAGIC_SHARD);
+            writeValue<uint64_t>(os, shardIndex);
+            writeValue<uint64_t>(os, numShards);
+            writeValue<uint64_t>(os, keys.size());
+            writeValue<uint64_t>(os, blob.size());
+            os.write(blob.data(), std::streamsize(blob.size()));
+        }
+
+        /**
+         * Merge shard files, given in the order of their shard index, into a single file.
+         * Only the headers are checked, and the shards are copied to the output without modification.
+         */
+        static void merge(std::span<const std::filesystem::path> shardFiles, std::ostream &os) {
+            std::vector<uint64_t> offsets = { 0 };
+            std::vector<std::pair<std::streamoff, size_t>> blobs; // Begin and size
+            for (size_t i = 0; i < shardFiles.size(); i++) {
+                std::ifstream is(shardFiles[i], std::ios::binary);
+                if (readValue<uint64_t>(is) != MAGIC_SHARD) {
+                    throw std::invalid_argument(shardFiles[i].string() + " is not a shard file");
+                }
+                if (readValue<uint64_t>(is) != i || readValue<uint64_t>(is) != shardFiles.size()) {
+                    throw std::invalid_argument(shardFiles[i].string() + " has an unexpected shard index");
+                }
+                size_t shardKeys = readValue<uint64_t>(is);
+                size_t blobSize = readValue<uint64_t>(is);
+                std::streamoff blobBegin = is.tellg();
+                if (!is || blobBegin + std::streamoff(blobSize) != std::streamoff(std::filesystem::file_size(shardFiles[i]))) {
+                    throw std::invalid_argument(shardFiles[i].string() + " is truncated");
+                }
+                if (Shard::readHeader(is).numKeys != shardKeys) {
+                    throw std::invalid_argument(shardFiles[i].string() + " has an inconsistent header");
+                }
+                blobs.emplace_back(blobBegin, blobSize);
+                offsets.push_back(offsets.back() + shardKeys);
+            }
+            writeValue(os, MAGIC_MERGED);
+            writeVector(os, offsets);
+            std::vector<char> buffer;
+            for (size_t i = 0; i < shardFiles.size(); i++) {
+                std::ifstream is(shardFiles[i], std::ios::binary);
+                is.seekg(blobs[i].first);
+                buffer.resize(blobs[i].second);
+                is.read(buffer.data(), std::streamsize(buffer.size()));
+                os.write(buffer.data(), std::streamsize(buffer.size()));
+            }
+            if (!os) {
+                throw std::runtime_error("Unable to write merged file");
+            }
+        }
+
+        [[nodiscard]] size_t numKeys() const {
+            return offsets.back();
+        }
+
+        [[nodiscard]] size_t numShards() const {
+            return shards.size();
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            size_t bits = 64 * offsets.size();
+            for (const std::unique_ptr<Shard> &shard : shards) {
+                bits += shard->getBits();
+            }
+            return bits;
+        }
+
+        [[nodiscard]] size_t operator()(const std::string &key) const {
+            return this->operator()(bytehamster::util::MurmurHash64(key));
+        }
+
+        [[nodiscard]] size_t operator()(uint64_t key) const {
+            size_t shard = shardOf(key, shards.size());
+            return offsets[shard] + shards[shard]->operator()(key);
+        }
+};
+} // namespace consensus
@@ -2,6 +2,9 @@
 
 #include <vector>
 #include <span>
+#include <algorithm>
+#include <memory>
+#include <memory_resource>
 #include <map>
 #include <bytehamster/util/EliasFano.h>
 #include <bytehamster/util/MurmurHash64.h>
@@ -10,26 +13,75 @@
 #include <bytehamster/util/IntVector.h>
 #include <Fips.h>
 
+#include "Serialization.h"
+#include "FreePositions.h"
+
 namespace consensus {
+template <typename BucketingFunction>
+class FrozenBucketing;
+
+/**
+ * Parameters of the bucketing layers of BumpedKPerfectHashFunction.
+ * Buckets of the first layers get more than k keys on average, with an expected load of 1/overloadFactor.
+ * Thresholds smaller than 1-1/thresholdTrimming of the expected threshold are not represented,
+ * the remaining range is split into 2^thresholdBits values.
+ * Keys that none of the numLayers layers accepts are handled by the fallback PHF.
+ */
+template <double overloadFactor, size_t thresholdTrimming, size_t thresholdBits, size_t numLayers>
+struct BumpingParameters {
+    static_assert(overloadFactor > 0 && overloadFactor <= 1);
+    static_assert(thresholdTrimming >= 2);
+    static_assert(thresholdBits >= 1 && thresholdBits < 32);
+    static_assert(numLayers >= 1);
+    static constexpr double OVERLOAD_FACTOR = overloadFactor;
+    static constexpr size_t THRESHOLD_TRIMMING = thresholdTrimming;
+    static constexpr size_t THRESHOLD_BITS = thresholdBits;
+    static constexpr size_t NUM_LAYERS = numLayers;
+};
+
+/**
+ * Parameters that work well for the given k.
+ */
+template <size_t k>
+using DefaultBumpingParameters = BumpingParameters<
+        k <= 256 ? 0.9 : (k <= 16384 ? 0.95 : 0.97),
+        k <= 8 ? 2 : (k <= 256 ? 3 : (k <= 512 ? 4 : 8)),
+        tlx::integer_log2_floor(k) - 1,
+        2>;
+
 /**
  * If the number of input keys is not a multiple of k,
  * this generates a minimal 1-perfect hash function on the remaining keys.
  * This is useful for Consensus, but might need an unexpectedly high amount of space for other uses.
+ * <code>Parameters</code> is a BumpingParameters instance. Serialized instances do not contain the parameters,
+ * so they must be loaded with the same ones.
  */
-template <size_t k>
+template <size_t k, typename Parameters = DefaultBumpingParameters<k>>
 class BumpedKPerfectHashFunction {
-        static constexpr double OVERLOAD_FACTOR = k <= 256 ? 0.9 : (k <= 16384 ? 0.95 : 0.97);
+        static constexpr double OVERLOAD_FACTOR = Parameters::OVERLOAD_FACTOR;
         // Thresholds smaller than 1-1/t are not represented
-        static constexpr size_t THRESHOLD_TRIMMING = k <= 8 ? 2 : (k <= 256 ? 3 : (k <= 512 ? 4 : 8));
-        static constexpr size_t THRESHOLD_BITS = tlx::integer_log2_floor(k) - 1;
-        static_assert(THRESHOLD_BITS < 64);
+        static constexpr size_t THRESHOLD_TRIMMING = Parameters::THRESHOLD_TRIMMING;
+        static constexpr size_t THRESHOLD_BITS = Parameters::THRESHOLD_BITS;
+        static constexpr size_t NUM_LAYERS = Parameters::NUM_LAYERS;
         static constexpr size_t THRESHOLD_RANGE = 1ul << THRESHOLD_BITS;
-
+    public:
         struct LayerInfo {
             uint32_t base;
             uint32_t expectedThreshold;
         };
 
+        /**
+         * Contents of this function as plain arrays, for example to embed it into source code.
+         * Instead of the fallback PHF, the keys that reach it are listed explicitly,
+         * sorted by their hash and together with their result. See <code>queryArrays</code>.
+         */
+        struct Arrays {
+            std::vector<uint32_t> thresholds;
+            std::vector<LayerInfo> layers;
+            std::vector<uint64_t> fallbackHashes;
+            std::vector<uint64_t> fallbackResults;
+        };
+    private:
         struct KeyInfo {
             uint64_t mhc;
             uint32_t bucket;
@@ -41,16 +93,21 @@ class BumpedKPerfectHashFunction {
         std::vector<LayerInfo> layerInfo;
         using fallback_phf_t = fips::FiPS<512, uint32_t, false>;
         fallback_phf_t fallbackPhf;
-        pasta::BitVector freePositionsBv;
-        pasta::FlatRankSelect<pasta::OptimizedFor::ONE_QUERIES> *freePositionsRankSelect = nullptr;
+        // Sorted hashes of the keys that reach the fallback PHF, which cannot be serialized directly
+        std::vector<uint64_t> fallbackHashes;
+        FreePositions freePositionMapping;
     public:
-        explicit BumpedKPerfectHashFunction(std::span<const uint64_t> keys)
+        /**
+         * The temporary buffers of the construction are allocated from <code>scratch</code>.
+         */
+        explicit BumpedKPerfectHashFunction(std::span<const uint64_t> keys,
+                                            std::pmr::memory_resource *scratch = std::pmr::get_default_resource())
                 : N(keys.size()), thresholds(std::max(1ul, N / k)) {
             size_t nbuckets = N / k;
             size_t keysInEndBucket = N - nbuckets * k;
             size_t bucketsThisLayer = (size_t) std::ceil(OVERLOAD_FACTOR * nbuckets);
-            std::vector<size_t> freePositions;
-            std::vector<KeyInfo> hashes;
+            std::pmr::vector<size_t> freePositions(scratch);
+            std::pmr::vector<KeyInfo> hashes(scratch);
             hashes.reserve(keys.size());
             for (uint64_t key : keys) {
                 uint64_t mhc = key;
@@ -58,20 +115,22 @@ class BumpedKPerfectHashFunction {
                 uint32_t threshold = mhc >> 32;
                 hashes.emplace_back(mhc, bucket, threshold);
             }
-            std::vector<KeyInfo> allHashes = hashes;
             layerInfo.push_back(LayerInfo{ 0, 0 });
-            for (size_t layer = 0; layer < 2; layer++) {
+            for (size_t layer = 0; layer < NUM_LAYERS; layer++) {
                 const size_t layerBase = layerInfo.back().base;
                 if (bucketsThisLayer == 0) {
                     break;
                 }
                 if (layer != 0) {
-                    assert(layer == 1);
                     if (nbuckets <= layerBase) {
-                        // Just keep 1 layer in this data structure
+                        // All buckets are already assigned to the previous layers
                         break;
                     }
+                    // Intermediate layers are overloaded as well, the last one takes all remaining buckets
                     bucketsThisLayer = nbuckets - layerBase;
+                    if (layer + 1 < NUM_LAYERS) {
+                        bucketsThisLayer = (size_t) std::ceil(OVERLOAD_FACTOR * bucketsThisLayer);
+                    }
                     // Rehash
                     for (auto & hash : hashes) {
                         hash.mhc = ::bytehamster::util::remix(hash.mhc);
@@ -84,7 +143,7 @@ class BumpedKPerfectHashFunction {
                 layerInfo.push_back(LayerInfo{ 0, 0 });
                 layerInfo.back().base = layerBase + bucketsThisLayer;
                 ips2ra::sort(hashes.begin(), hashes.end(), [] (const KeyInfo &t) { return uint64_t(t.bucket) << 32 | t.threshold; });
-                std::vector<KeyInfo> bumpedKeys;
+                std::pmr::vector<KeyInfo> bumpedKeys(scratch);
                 size_t bucketStart = 0;
                 size_t previousBucket = 0;
                 for (size_t i = 0; i < hashes.size(); i++) {
@@ -101,7 +160,7 @@ class BumpedKPerfectHashFunction {
                     previousBucket++;
                     bucketStart = hashes.size();
                 }
-                hashes = bumpedKeys;
+                hashes = std::move(bumpedKeys);
                 //std::cout<<"Bumped in layer "<<layer<<": "<<hashes.size()<<std::endl;
             }
 
@@ -109,11 +168,12 @@ class BumpedKPerfectHashFunction {
                 return; // Nothing to repair
             }
 
-            std::vector<uint64_t> fallbackHashes;
             fallbackHashes.reserve(hashes.size());
             for (size_t i = 0; i < hashes.size(); i++) {
                 fallbackHashes.push_back(bytehamster::util::MurmurHash64(hashes.at(i).mhc));
             }
+            // Sorted, so that loading a serialized instance reproduces exactly the same fallback PHF
+            std::sort(fallbackHashes.begin(), fallbackHashes.end());
             fallbackPhf = fallback_phf_t(fallbackHashes, 1.0);
             size_t additionalFreePositions = hashes.size() - freePositions.size();
             size_t nbucketsHandled = layerInfo.back().base;
@@ -122,21 +182,100 @@ class BumpedKPerfectHashFunction {
                 for (; i < additionalFreePositions - keysInEndBucket; i++) {
                     freePositions.push_back(nbucketsHandled + i/k);
                 }
-                for (; i < additionalFreePositions; i++) {
-                    freePositions.push_back(nbuckets + i);
+                // Positions of the last half-filled bucket, which evaluateFallback maps back behind the full buckets
+                for (size_t j = 0; i < additionalFreePositions; i++, j++) {
+                    freePositions.push_back(nbuckets + j);
                 }
             }
-            if (!freePositions.empty()) {
-                freePositionsBv.resize(freePositions.size() + freePositions.back() + 1, false);
-                for (size_t i = 0; i < freePositions.size(); i++) {
-                    freePositionsBv[i + freePositions.at(i)] = true;
-                }
-                freePositionsRankSelect = new pasta::FlatRankSelect<pasta::OptimizedFor::ONE_QUERIES>(freePositionsBv);
+            freePositionMapping.build(freePositions);
+        }
+
+        // The rank/select variant of the free positions refers to its own bit vector, so instances stay in place
+        BumpedKPerfectHashFunction(BumpedKPerfectHashFunction &&) = delete;
+        BumpedKPerfectHashFunction &operator=(BumpedKPerfectHashFunction &&) = delete;
+
+        /**
+         * Load an instance that was written using writeToStream.
+         */
+        explicit BumpedKPerfectHashFunction(std::istream &is)
+                : N(readValue<uint64_t>(is)), thresholds(std::max(1ul, N / k)) {
+            std::vector<uint32_t> thresholdValues = readVector<uint32_t>(is);
+            if (thresholdValues.size() != std::max(1ul, N / k)) {
+                throw std::invalid_argument("Invalid number of thresholds");
+            }
+            for (size_t i = 0; i < thresholdValues.size(); i++) {
+                thresholds.set(i, thresholdValues[i]);
+            }
+            layerInfo = readVector<LayerInfo>(is);
+            if (layerInfo.empty() || layerInfo.size() > NUM_LAYERS + 1) {
+                throw std::invalid_argument("Number of layers does not match the parameters");
+            }
+            fallbackHashes = readVector<uint64_t>(is);
+            if (!fallbackHashes.empty()) {
+                fallbackPhf = fallback_phf_t(fallbackHashes, 1.0);
+            }
+            freePositionMapping.readFromStream(is);
+        }
+
+        /**
+         * Serialize this instance.
+         * Instead of the fallback PHF, we store the hashes of the keys that reach it and rebuild it when loading.
+         */
+        void writeToStream(std::ostream &os) const {
+            writeValue<uint64_t>(os, N);
+            std::vector<uint32_t> thresholdValues(std::max(1ul, N / k));
+            for (size_t i = 0; i < thresholdValues.size(); i++) {
+                thresholdValues[i] = thresholds.at(i);
+            }
+            writeVector(os, thresholdValues);
+            writeVector(os, layerInfo);
+            writeVector(os, fallbackHashes);
+            freePositionMapping.writeToStream(os);
+        }
+
+        /**
+         * Export the data of this function.
+         */
+        [[nodiscard]] Arrays toArrays() const {
+            Arrays arrays;
+            arrays.thresholds.resize(std::max(1ul, N / k));
+            for (size_t i = 0; i < arrays.thresholds.size(); i++) {
+                arrays.thresholds[i] = thresholds.at(i);
+            }
+            arrays.layers = layerInfo;
+            arrays.fallbackHashes = fallbackHashes;
+            arrays.fallbackResults.reserve(fallbackHashes.size());
+            for (uint64_t hash : fallbackHashes) {
+                arrays.fallbackResults.push_back(fallbackResult(hash));
             }
+            return arrays;
+        }
+
+        /**
+         * Evaluate a function that was exported using <code>toArrays</code>.
+         * The key must be one of the input keys, otherwise the fallback lookup can return any result.
+         * <code>thresholds</code> can be any type whose index operator returns the threshold.
+         */
+        template <typename Thresholds>
+        [[nodiscard]] static inline size_t queryArrays(uint64_t mhc,
+                const Thresholds &thresholds, std::span<const LayerInfo> layers,
+                std::span<const uint64_t> fallbackHashes, std::span<const uint64_t> fallbackResults) {
+            size_t bucket;
+            if (evaluateLayers(mhc, bucket, layers, [&](size_t i) { return thresholds[i]; })) {
+                return bucket;
+            }
+            auto it = std::lower_bound(fallbackHashes.begin(), fallbackHashes.end(), bytehamster::util::MurmurHash64(mhc));
+            if (it == fallbackHashes.end()) {
+                return 0; // Not an input key
+            }
+            return fallbackResults[it - fallbackHashes.begin()];
         }
 
         uint32_t compact_threshold(uint32_t threshold, size_t layer) const {
-            size_t expected = layerInfo.at(layer).expectedThreshold;
+            return compactThreshold(threshold, layerInfo.at(layer).expectedThreshold);
+        }
+
+        static inline uint32_t compactThreshold(uint32_t threshold, size_t expected) {
             size_t interpolationRange = expected / THRESHOLD_TRIMMING;
             size_t minThreshold = expected - interpolationRange;
             assert(minThreshold > 0);
@@ -148,8 +287,8 @@ class BumpedKPerfectHashFunction {
         }
 
         void flushBucket(size_t layer, size_t bucketStart, size_t i, size_t bucketIdx,
-                         std::vector<KeyInfo> &hashes, std::vector<KeyInfo> &bumpedKeys,
-                         std::vector<size_t> &freePositions) {
+                         std::pmr::vector<KeyInfo> &hashes, std::pmr::vector<KeyInfo> &bumpedKeys,
+                         std::pmr::vector<size_t> &freePositions) {
             size_t bucketSize = i - bucketStart;
             size_t layerBase = layerInfo.at(layer).base;
             if (bucketSize <= k) {
@@ -178,13 +317,15 @@ class BumpedKPerfectHashFunction {
             }
         }
 
-        /** Estimate for the space usage of this structure, in bits */
+        /**
+         * Estimate for the space usage of this structure, in bits.
+         * Does not include the fallback hashes, which queries do not need.
+         */
         [[nodiscard]] size_t getBits() const {
             return 8 * sizeof(*this)
                    + fallbackPhf.getBits()
                    + layerInfo.size() * sizeof(LayerInfo) * 8
-                   + freePositionsBv.space_usage() - 8 * sizeof(freePositionsBv) // Already in sizeof(*this)
-                   + ((freePositionsRankSelect == nullptr) ? 0 : 8 * freePositionsRankSelect->space_usage())
+                   + freePositionMapping.getBits()
                    + 8 * thresholds.dataSizeBytes();
         }
 
@@ -195,37 +336,93 @@ class BumpedKPerfectHashFunction {
             std::cout << "Fallback PHF keys: " << fallbackPhf.getN() << std::endl;
             std::cout << "PHF internal: " << 1.0f*fallbackPhf.getBits() / fallbackPhf.getN() << std::endl;
             std::cout << "PHF: " << 1.0f*fallbackPhf.getBits() / N << std::endl;
-            if (freePositionsBv.size() > 0) {
-                std::cout << "Fano: " << 1.0f*(freePositionsBv.space_usage() + 8 * freePositionsRankSelect->space_usage()) / N << std::endl;
-                std::cout << "Fano size: " << freePositionsBv.size() << std::endl;
+            std::cout << "Fallback hashes for serialization: " << 64.0f*fallbackHashes.size() / N << std::endl;
+            if (!freePositionMapping.empty()) {
+                std::cout << "Free positions: " << 1.0f*freePositionMapping.getBits() / N
+                          << " (" << FreePositions::strategyName(freePositionMapping.strategy()) << ")" << std::endl;
             }
         }
 
+        /**
+         * Returns true if the key is handled by the fallback PHF, which is the slowest query path.
+         */
+        [[nodiscard]] bool isFallback(uint64_t mhc) const {
+            size_t bucket;
+            return !evaluateLayers(mhc, bucket);
+        }
+
+        [[nodiscard]] size_t getN() const {
+            return N;
+        }
+
+        [[nodiscard]] const FreePositions &getFreePositions() const {
+            return freePositionMapping;
+        }
+
         size_t operator() (const std::string &key) const {
             return operator()(::bytehamster::util::MurmurHash64(key));
         }
 
         inline size_t operator()(uint64_t mhc) const {
-            for (size_t layer = 0; layer < layerInfo.size() - 1; layer++) {
+            size_t layerBucket;
+            if (evaluateLayers(mhc, layerBucket)) {
+                return layerBucket;
+            }
+            return evaluateFallback(mhc);
+        }
+
+    private:
+        template <typename BucketingFunction>
+        friend class FrozenBucketing;
+
+        /**
+         * Result of a key that none of the layers accepts, with <code>mhc</code> rehashed like by evaluateLayers.
+         */
+        size_t evaluateFallback(uint64_t mhc) const {
+            return fallbackResult(bytehamster::util::MurmurHash64(mhc));
+        }
+
+        size_t fallbackResult(uint64_t fallbackHash) const {
+            size_t phf = fallbackPhf(fallbackHash);
+            size_t bucket = freePositionMapping.at(phf);
+            // With a single layer, not all full buckets belong to a layer
+            size_t nbuckets = N / k;
+            if (bucket >= nbuckets) { // Last half-filled bucket
+                return bucket - nbuckets + k * nbuckets;
+            }
+            return bucket;
+        }
+
+        /**
+         * Returns true if one of the layers accepts the key, storing the result in <code>bucket</code>.
+         * Otherwise, <code>mhc</code> is the rehashed value that the fallback uses.
+         */
+        inline bool evaluateLayers(uint64_t &mhc, size_t &bucket) const {
+            return evaluateLayers(mhc, bucket, layerInfo, [&](size_t i) { return thresholds.at(i); });
+        }
+
+        /**
+         * Shared by the instance and the plain array representation,
+         * which store the thresholds differently.
+         */
+        template <typename ThresholdAt>
+        static inline bool evaluateLayers(uint64_t &mhc, size_t &bucket,
+                                          std::span<const LayerInfo> layers, ThresholdAt thresholdAt) {
+            for (size_t layer = 0; layer < layers.size() - 1; layer++) {
                 if (layer != 0) {
                     mhc = ::bytehamster::util::remix(mhc);
                 }
-                size_t base = layerInfo.at(layer).base;
-                size_t layerSize = layerInfo.at(layer + 1).base - base;
-                uint32_t bucket = ::bytehamster::util::fastrange32(mhc & 0xffffffff, layerSize);
+                size_t base = layers[layer].base;
+                size_t layerSize = layers[layer + 1].base - base;
+                uint32_t layerBucket = ::bytehamster::util::fastrange32(mhc & 0xffffffff, layerSize);
                 uint32_t threshold = mhc >> 32;
-                uint64_t storedThreshold = thresholds.at(base + bucket);
-                if (compact_threshold(threshold, layer) <= storedThreshold) {
-                    return base + bucket;
+                uint64_t storedThreshold = thresholdAt(base + layerBucket);
+                if (compactThreshold(threshold, layers[layer].expectedThreshold) <= storedThreshold) {
+                    bucket = base + layerBucket;
+                    return true;
                 }
             }
-            size_t phf = fallbackPhf(bytehamster::util::MurmurHash64(mhc));
-            size_t bucket = freePositionsRankSelect->select1(phf + 1) - phf;
-            size_t nbuckets = layerInfo.back().base;
-            if (bucket >= nbuckets) { // Last half-filled bucket
-                return bucket - nbuckets + k * nbuckets;
-            }
-            return bucket;
+            return false;
         }
 };
 } // namespace consensus
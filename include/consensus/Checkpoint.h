@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+
+#include "Serialization.h"
+
+namespace consensus {
+/**
+ * Periodically write the state of a long-running construction to a file.
+ * If the file already exists when starting a construction, the construction resumes from there.
+ */
+struct CheckpointConfig {
+    std::filesystem::path file;
+    std::chrono::seconds interval = std::chrono::minutes(10);
+};
+
+/**
+ * Writes checkpoints at most once per configured interval.
+ * The file is first written to a temporary location and then renamed,
+ * so an interruption while writing never destroys the previous checkpoint.
+ */
+class Checkpointer {
+        static constexpr uint64_t MAGIC = 0x54504b4353524e43; // "CNRSCKPT"
+        CheckpointConfig config;
+        uint64_t identifier;
+        std::chrono::steady_clock::time_point lastCheckpoint;
+    public:
+        /**
+         * The identifier should cover all parameters and the input keys,
+         * so that we never resume a construction with a checkpoint of a different one.
+         */
+        Checkpointer(CheckpointConfig config, uint64_t identifier)
+                : config(std::move(config)), identifier(identifier), lastCheckpoint(std::chrono::steady_clock::now()) {
+        }
+
+        [[nodiscard]] bool isDue() const {
+            return std::chrono::steady_clock::now() - lastCheckpoint >= config.interval;
+        }
+
+        template <typename WriteState>
+        void write(WriteState writeState) {
+            std::filesystem::path temporaryFile = config.file;
+            temporaryFile += ".tmp";
+            {
+                std::ofstream os(temporaryFile, std::ios::binary | std::ios::trunc);
+                writeValue(os, MAGIC);
+                writeValue(os, identifier);
+                writeState(os);
+                if (!os) {
+                    throw std::runtime_error("Unable to write checkpoint " + temporaryFile.string());
+                }
+            }
+            std::filesystem::rename(temporaryFile, config.file);
+            lastCheckpoint = std::chrono::steady_clock::now();
+        }
+
+        /**
+         * Opens the checkpoint file, positioned after the header, if there is one.
+         */
+        [[nodiscard]] std::optional<std::ifstream> open() const {
+            if (!std::filesystem::exists(config.file)) {
+                return std::nullopt;
+            }
+            std::ifstream is(config.file, std::ios::binary);
+            if (readValue<uint64_t>(is) != MAGIC) {
+                throw std::invalid_argument(config.file.string() + " is not a checkpoint");
+            }
+            if (readValue<uint64_t>(is) != identifier) {
+                throw std::invalid_argument(config.file.string() + " belongs to a different construction");
+            }
+            return is;
+        }
+
+        void remove() const {
+            std::filesystem::remove(config.file);
+        }
+};
+} // namespace consensus
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace consensus {
+// The code between the markers is copied into the headers generated by tools/code_generator.cpp,
+// so it must stay self-contained and may only use <array> and <cstdint>.
+// CONSTEXPR_QUERY_BEGIN
+/**
+ * Query of ConsensusRecSplitQueryOptimized with the default split and bumping functions,
+ * evaluated on plain arrays and usable in constant expressions.
+ */
+namespace constexpr_query {
+struct Parameters {
+    std::uint64_t numKeys;
+    std::uint64_t k;
+    std::uint64_t logk;
+    std::uint64_t treeBits; // Bits of the seeds of one splitting tree
+    std::uint64_t thresholdRange;
+    std::uint64_t thresholdTrimming;
+};
+
+struct Layer {
+    std::uint32_t base;
+    std::uint32_t expectedThreshold;
+};
+
+/**
+ * Seed positions in units of 2^-20 bits, see QueryOptimizedLayout.
+ */
+struct Level {
+    std::uint64_t microBitsBefore;
+    std::uint64_t microBitsForSplit;
+    std::uint64_t microBitsForFirstSplit;
+};
+
+constexpr std::uint64_t remix(std::uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ul;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebul;
+    return z ^ (z >> 31);
+}
+
+constexpr std::uint64_t MURMUR_MULTIPLIER = 0xc6a4a7935bd1e995ul;
+
+constexpr std::uint64_t murmurMixBlock(std::uint64_t h, std::uint64_t block) {
+    block *= MURMUR_MULTIPLIER;
+    block ^= block >> 47;
+    block *= MURMUR_MULTIPLIER;
+    return (h ^ block) * MURMUR_MULTIPLIER;
+}
+
+constexpr std::uint64_t murmurFinalize(std::uint64_t h) {
+    h ^= h >> 47;
+    h *= MURMUR_MULTIPLIER;
+    return h ^ (h >> 47);
+}
+
+/**
+ * MurmurHash64A of the bytes, like bytehamster::util::MurmurHash64 on little-endian machines.
+ */
+constexpr std::uint64_t murmurHash64(const char *data, std::uint64_t length) {
+    std::uint64_t h = length * MURMUR_MULTIPLIER;
+    std::uint64_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        std::uint64_t block = 0;
+        for (std::uint64_t byte = 0; byte < 8; byte++) {
+            block |= std::uint64_t(std::uint8_t(data[i + byte])) << (8 * byte);
+        }
+        h = murmurMixBlock(h, block);
+    }
+    if (i < length) {
+        for (std::uint64_t byte = 0; i + byte < length; byte++) {
+            h ^= std::uint64_t(std::uint8_t(data[i + byte])) << (8 * byte);
+        }
+        h *= MURMUR_MULTIPLIER;
+    }
+    return murmurFinalize(h);
+}
+
+constexpr std::uint64_t murmurHash64(std::uint64_t key) {
+    return murmurFinalize(murmurMixBlock(8 * MURMUR_MULTIPLIER, key));
+}
+
+constexpr std::uint64_t compactThreshold(std::uint64_t threshold, std::uint64_t expected, const Parameters &parameters) {
+    std::uint64_t interpolationRange = expected / parameters.thresholdTrimming;
+    std::uint64_t minThreshold = expected - interpolationRange;
+    if (threshold < minThreshold) {
+        return 1;
+    }
+    std::uint64_t compacted = 1 + (parameters.thresholdRange - 1) * (threshold - minThreshold) / interpolationRange;
+    return compacted < parameters.thresholdRange - 1 ? compacted : parameters.thresholdRange - 1;
+}
+
+template <typename Thresholds, typename Layers, typename FallbackHashes, typename FallbackResults>
+constexpr std::uint64_t bucketOf(std::uint64_t mhc, const Parameters &parameters, const Thresholds &thresholds,
+                                 const Layers &layers, const FallbackHashes &fallbackHashes,
+                                 const FallbackResults &fallbackResults) {
+    for (std::uint64_t layer = 0; layer + 1 < layers.size(); layer++) {
+        if (layer != 0) {
+            mhc = remix(mhc);
+        }
+        std::uint64_t base = layers[layer].base;
+        std::uint64_t layerSize = layers[layer + 1].base - base;
+        std::uint64_t bucket = base + (((mhc & 0xffffffff) * layerSize) >> 32);
+        if (compactThreshold(mhc >> 32, layers[layer].expectedThreshold, parameters) <= thresholds[bucket]) {
+            return bucket;
+        }
+    }
+    // Binary search for the first hash that is not smaller
+    std::uint64_t hash = murmurHash64(mhc);
+    std::uint64_t begin = 0;
+    std::uint64_t end = fallbackHashes.size();
+    while (begin < end) {
+        std::uint64_t middle = (begin + end) / 2;
+        if (fallbackHashes[middle] < hash) {
+            begin = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+    return begin == fallbackHashes.size() ? 0 : fallbackResults[begin]; // 0 if not an input key
+}
+
+template <typename Levels>
+constexpr std::uint64_t seedStartPosition(const Levels &levels, std::uint64_t level, std::uint64_t index) {
+    std::uint64_t microBits = levels[level].microBitsBefore;
+    if (index > 0) {
+        microBits += levels[level].microBitsForSplit * (index - 1) + levels[level].microBitsForFirstSplit;
+    }
+    return microBits / (1024 * 1024);
+}
+
+/**
+ * The 64 bits that end at the bit position, see UnalignedBitVector::readAt.
+ */
+template <typename Seeds>
+constexpr std::uint64_t readSeed(const Seeds &seeds, std::uint64_t bitPosition) {
+    if (bitPosition % 64 == 0) {
+        return seeds[bitPosition / 64];
+    }
+    return (seeds[bitPosition / 64] << (bitPosition % 64)) | (seeds[bitPosition / 64 + 1] >> (64 - (bitPosition % 64)));
+}
+
+/**
+ * Evaluates the function for a key that is already a 64-bit hash value.
+ */
+template <typename Seeds, typename Levels, typename Thresholds, typename Layers,
+          typename FallbackHashes, typename FallbackResults>
+constexpr std::uint64_t query(std::uint64_t key, const Parameters &parameters, const Seeds &seeds,
+                              const Levels &levels, const Thresholds &thresholds, const Layers &layers,
+                              const FallbackHashes &fallbackHashes, const FallbackResults &fallbackResults) {
+    std::uint64_t bucket = bucketOf(key, parameters, thresholds, layers, fallbackHashes, fallbackResults);
+    if (bucket >= parameters.numKeys / parameters.k) {
+        return bucket; // Fallback if k does not divide the number of keys
+    }
+    std::uint64_t treeBegin = bucket * parameters.treeBits;
+    std::uint64_t index = 0;
+    for (std::uint64_t level = 0; level < parameters.logk; level++) {
+        std::uint64_t endPosition = treeBegin + (index + 1 < (std::uint64_t(1) << level)
+                ? seedStartPosition(levels, level, index + 1) : seedStartPosition(levels, level + 1, 0));
+        std::uint64_t seed = readSeed(seeds, endPosition);
+        index = 2 * index + (remix(key + seed) % 2 == 0);
+    }
+    return bucket * parameters.k + index;
+}
+} // namespace constexpr_query
+// CONSTEXPR_QUERY_END
+} // namespace consensus
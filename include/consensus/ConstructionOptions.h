@@ -0,0 +1,156 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <utility>
+
+#include "Checkpoint.h"
+
+namespace consensus {
+/**
+ * Progress of a running construction, see ConstructionOptions::onProgress.
+ * The remaining time is extrapolated from the progress since the search started or resumed,
+ * so it is only a rough estimate and unknown until some progress was made.
+ */
+struct ConstructionProgress {
+    double fractionDone = 0;
+    std::chrono::steady_clock::duration elapsed{};
+    std::optional<std::chrono::steady_clock::duration> remaining;
+};
+
+/**
+ * Controls a long-running construction from outside.
+ * When the stop token is triggered or the deadline has passed, the construction throws ConstructionInterrupted.
+ * With a checkpoint configured, a checkpoint is written before, so a later construction can resume.
+ * A build orchestrator can use the estimated remaining time of the progress callback
+ * to request a stop for runs that will miss their window.
+ */
+struct ConstructionOptions {
+    std::stop_token stopToken = {};
+    std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt;
+    std::function<void(const ConstructionProgress &)> onProgress = nullptr;
+    std::chrono::milliseconds progressInterval = std::chrono::seconds(1);
+    std::optional<CheckpointConfig> checkpoint = std::nullopt;
+    // Status messages on std::cout, which builders of many small functions turn off
+    bool quiet = false;
+    // Temporary buffers of the construction. Builders of many small functions pass an arena that they reuse.
+    std::pmr::memory_resource *scratch = std::pmr::get_default_resource();
+};
+
+class ConstructionInterrupted : public std::runtime_error {
+    public:
+        enum class Reason { Cancelled, DeadlineExceeded };
+        Reason reason;
+
+        ConstructionInterrupted(Reason reason, double fractionDone)
+                : std::runtime_error(std::string(reason == Reason::Cancelled ? "Construction cancelled"
+                                                 : "Construction deadline exceeded")
+                                     + " at " + std::to_string(int(100 * fractionDone)) + "%"),
+                  reason(reason) {
+        }
+};
+
+/**
+ * Evaluates the options while the search is running. The search calls poll regularly,
+ * but not for every trial, because reading the clock is comparatively expensive.
+ */
+class ConstructionMonitor {
+        ConstructionOptions options;
+        std::optional<Checkpointer> checkpointer;
+        std::chrono::steady_clock::time_point begin;
+        std::chrono::steady_clock::time_point lastProgress;
+        // First poll, which is the reference for estimating the remaining time, also when resuming
+        std::optional<std::pair<std::chrono::steady_clock::time_point, double>> firstPoll;
+    public:
+        /**
+         * The identifier is only evaluated if checkpointing is enabled, see Checkpointer.
+         */
+        template <typename CheckpointIdentifier>
+        ConstructionMonitor(ConstructionOptions options, CheckpointIdentifier checkpointIdentifier)
+                : options(std::move(options)), begin(std::chrono::steady_clock::now()), lastProgress(begin) {
+            if (this->options.checkpoint.has_value()) {
+                checkpointer.emplace(*this->options.checkpoint, checkpointIdentifier());
+            }
+        }
+
+        [[nodiscard]] bool quiet() const {
+            return options.quiet;
+        }
+
+        [[nodiscard]] std::pmr::memory_resource *scratch() const {
+            return options.scratch;
+        }
+
+        [[nodiscard]] std::optional<std::ifstream> openCheckpoint() const {
+            if (!checkpointer.has_value()) {
+                return std::nullopt;
+            }
+            return checkpointer->open();
+        }
+
+        /**
+         * Throws if the construction should stop, otherwise reports progress and writes a checkpoint if due.
+         */
+        template <typename WriteState>
+        void poll(double fractionDone, WriteState writeState) {
+            auto now = std::chrono::steady_clock::now();
+            if (!firstPoll.has_value()) {
+                firstPoll.emplace(now, fractionDone);
+            }
+            if (options.stopToken.stop_requested()) {
+                interrupt(ConstructionInterrupted::Reason::Cancelled, fractionDone, writeState);
+            } else if (options.deadline.has_value() && now >= *options.deadline) {
+                interrupt(ConstructionInterrupted::Reason::DeadlineExceeded, fractionDone, writeState);
+            }
+            if (options.onProgress && now - lastProgress >= options.progressInterval) {
+                report(fractionDone, now);
+            }
+            if (checkpointer.has_value() && checkpointer->isDue()) {
+                checkpointer->write(writeState);
+            }
+        }
+
+        /**
+         * Called after a successful construction.
+         */
+        void finish() {
+            if (options.onProgress) {
+                report(1, std::chrono::steady_clock::now());
+            }
+            if (checkpointer.has_value()) {
+                checkpointer->remove();
+            }
+        }
+
+    private:
+        void report(double fractionDone, std::chrono::steady_clock::time_point now) {
+            ConstructionProgress progress;
+            progress.fractionDone = fractionDone;
+            progress.elapsed = now - begin;
+            if (firstPoll.has_value() && fractionDone > firstPoll->second && fractionDone < 1) {
+                double rate = (fractionDone - firstPoll->second) / std::chrono::duration<double>(now - firstPoll->first).count();
+                progress.remaining = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>((1 - fractionDone) / rate));
+            } else if (fractionDone >= 1) {
+                progress.remaining = std::chrono::steady_clock::duration::zero();
+            }
+            options.onProgress(progress);
+            lastProgress = now;
+        }
+
+        template <typename WriteState>
+        [[noreturn]] void interrupt(ConstructionInterrupted::Reason reason, double fractionDone, WriteState writeState) {
+            if (checkpointer.has_value()) {
+                checkpointer->write(writeState);
+            }
+            throw ConstructionInterrupted(reason, fractionDone);
+        }
+};
+} // namespace consensus
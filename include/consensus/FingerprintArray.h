@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <bytehamster/util/Function.h>
+#include <bytehamster/util/IntVector.h>
+
+#include "Serialization.h"
+
+namespace consensus {
+/**
+ * Stores a short fingerprint of each input key at the position that the perfect hash function maps it to.
+ * A key that is not part of the input set matches the fingerprint at its position
+ * with probability 2^-bits, so all other non-members can be rejected without an external lookup.
+ */
+template <size_t bits>
+class FingerprintArray {
+        static_assert(bits <= 32, "Fingerprints wider than 32 bits are not supported");
+        size_t n;
+        bytehamster::util::IntVector<bits> fingerprints;
+    public:
+        explicit FingerprintArray(size_t n) : n(n), fingerprints(n) {
+        }
+
+        [[nodiscard]] static inline uint64_t fingerprint(uint64_t key) {
+            // Separate from the bits that are used for bucketing and splitting
+            return bytehamster::util::remix(key ^ 0x9e3779b97f4a7c15ul) >> (64 - bits);
+        }
+
+        void set(size_t position, uint64_t key) {
+            fingerprints.set(position, fingerprint(key));
+        }
+
+        [[nodiscard]] inline bool matches(size_t position, uint64_t key) const {
+            return fingerprints.at(position) == fingerprint(key);
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return 8 * fingerprints.dataSizeBytes();
+        }
+
+        void writeToStream(std::ostream &os) const {
+            std::vector<uint64_t> packed((n * bits + 63) / 64 + 1);
+            for (size_t i = 0; i < n; i++) {
+                size_t bit = i * bits;
+                uint64_t value = fingerprints.at(i);
+                packed[bit / 64] |= value << (bit % 64);
+                if (bit % 64 != 0) {
+                    packed[bit / 64 + 1] |= value >> (64 - bit % 64);
+                }
+            }
+            writeVector(os, packed);
+        }
+
+        void readFromStream(std::istream &is) {
+            std::vector<uint64_t> packed = readVector<uint64_t>(is);
+            if (packed.size() != (n * bits + 63) / 64 + 1) {
+                throw std::invalid_argument("Invalid number of fingerprints");
+            }
+            for (size_t i = 0; i < n; i++) {
+                size_t bit = i * bits;
+                uint64_t value = packed[bit / 64] >> (bit % 64);
+                if (bit % 64 != 0) {
+                    value |= packed[bit / 64 + 1] << (64 - bit % 64);
+                }
+                fingerprints.set(i, value & ((1ul << bits) - 1));
+            }
+        }
+};
+
+/**
+ * Disabled fingerprints. Takes no space.
+ */
+template <>
+class FingerprintArray<0> {
+    public:
+        explicit FingerprintArray(size_t /* n */) {
+        }
+
+        void set(size_t /* position */, uint64_t /* key */) {
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return 0;
+        }
+
+        void writeToStream(std::ostream &/* os */) const {
+        }
+
+        void readFromStream(std::istream &/* is */) {
+        }
+};
+} // namespace consensus
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <variant>
+#include <vector>
+#include <bytehamster/util/EliasFano.h>
+#include <Fips.h>
+
+#include "Serialization.h"
+
+namespace consensus {
+/**
+ * Plain array of the free positions. Needs a single memory access, so it is used for tiny fallback sets.
+ */
+class SortedArrayFreePositions {
+        std::vector<uint32_t> positions;
+    public:
+        explicit SortedArrayFreePositions(std::span<const size_t> freePositions)
+                : positions(freePositions.begin(), freePositions.end()) {
+        }
+
+        [[nodiscard]] inline size_t at(size_t i) const {
+            return positions[i];
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return 8 * sizeof(*this) + 32 * positions.size();
+        }
+};
+
+/**
+ * Elias-Fano coding with a few lower bits, which is smaller than the unary coding of the
+ * rank/select variant if the free positions are sparse compared to the number of buckets.
+ */
+class EliasFanoFreePositions {
+        static constexpr int LOWER_BITS = 2;
+        // Access is logically const, but the util implementation does not mark it
+        mutable bytehamster::util::EliasFano<LOWER_BITS> eliasFano;
+    public:
+        explicit EliasFanoFreePositions(std::span<const size_t> freePositions)
+                : eliasFano(freePositions.size(), freePositions.back() + 1) {
+            for (size_t position : freePositions) {
+                eliasFano.push_back(position);
+            }
+            eliasFano.buildRankSelect();
+        }
+
+        [[nodiscard]] inline size_t at(size_t i) const {
+            return *eliasFano.at(i);
+        }
+
+        [[nodiscard]] static size_t estimateBits(size_t numPositions, size_t universe) {
+            return numPositions * (LOWER_BITS + 1) + (universe >> LOWER_BITS);
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return 8 * eliasFano.space();
+        }
+};
+
+/**
+ * Unary coding of the free positions in a bit vector, with select to find the i-th one.
+ * This is Elias-Fano without lower bits, so it is compact for dense free positions.
+ */
+class RankSelectFreePositions {
+        pasta::BitVector bitVector;
+        std::unique_ptr<pasta::FlatRankSelect<pasta::OptimizedFor::ONE_QUERIES>> rankSelect;
+    public:
+        explicit RankSelectFreePositions(std::span<const size_t> freePositions) {
+            bitVector.resize(freePositions.size() + freePositions.back() + 1, false);
+            for (size_t i = 0; i < freePositions.size(); i++) {
+                bitVector[i + freePositions[i]] = true;
+            }
+            rankSelect = std::make_unique<pasta::FlatRankSelect<pasta::OptimizedFor::ONE_QUERIES>>(bitVector);
+        }
+
+        // The rank/select structure refers to the data of the bit vector
+        RankSelectFreePositions(RankSelectFreePositions &&) = delete;
+        RankSelectFreePositions &operator=(RankSelectFreePositions &&) = delete;
+
+        [[nodiscard]] inline size_t at(size_t i) const {
+            return rankSelect->select1(i + 1) - i;
+        }
+
+        [[nodiscard]] static size_t estimateBits(size_t numPositions, size_t universe) {
+            return numPositions + universe;
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return bitVector.space_usage() + 8 * rankSelect->space_usage();
+        }
+};
+
+/**
+ * Maps the result of the fallback PHF to the bucket with the corresponding free position.
+ * The representation is chosen when building, depending on the number of free positions.
+ */
+class FreePositions {
+    public:
+        enum class Strategy : uint8_t { AUTOMATIC, SORTED_ARRAY, ELIAS_FANO, RANK_SELECT };
+        // At most 512 bytes, so the array is likely to stay in cache
+        static constexpr size_t SMALL_FALLBACK = 128;
+    private:
+        // Alternatives in the same order as the strategies
+        std::variant<std::monostate, SortedArrayFreePositions, EliasFanoFreePositions, RankSelectFreePositions> representation;
+        size_t numPositions = 0;
+    public:
+        /**
+         * Free positions must be sorted.
+         */
+        void build(std::span<const size_t> freePositions, Strategy strategy = Strategy::AUTOMATIC) {
+            numPositions = freePositions.size();
+            if (freePositions.empty()) {
+                representation.emplace<std::monostate>();
+                return;
+            }
+            if (strategy == Strategy::AUTOMATIC) {
+                size_t universe = freePositions.back() + 1;
+                if (freePositions.size() <= SMALL_FALLBACK) {
+                    strategy = Strategy::SORTED_ARRAY;
+                } else if (EliasFanoFreePositions::estimateBits(freePositions.size(), universe)
+                           < RankSelectFreePositions::estimateBits(freePositions.size(), universe)) {
+                    strategy = Strategy::ELIAS_FANO;
+                } else {
+                    strategy = Strategy::RANK_SELECT;
+                }
+            }
+            switch (strategy) {
+                case Strategy::SORTED_ARRAY:
+                    representation.emplace<SortedArrayFreePositions>(freePositions);
+                    break;
+                case Strategy::ELIAS_FANO:
+                    representation.emplace<EliasFanoFreePositions>(freePositions);
+                    break;
+                default:
+                    representation.emplace<RankSelectFreePositions>(freePositions);
+                    break;
+            }
+        }
+
+        [[nodiscard]] inline size_t at(size_t i) const {
+            return std::visit([&](const auto &r) -> size_t {
+                if constexpr (std::is_same_v<std::decay_t<decltype(r)>, std::monostate>) {
+                    return 0;
+                } else {
+                    return r.at(i);
+                }
+            }, representation);
+        }
+
+        [[nodiscard]] size_t size() const {
+            return numPositions;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return numPositions == 0;
+        }
+
+        [[nodiscard]] Strategy strategy() const {
+            return representation.index() == 0 ? Strategy::AUTOMATIC : Strategy(representation.index());
+        }
+
+        [[nodiscard]] static const char *strategyName(Strategy strategy) {
+            switch (strategy) {
+                case Strategy::SORTED_ARRAY: return "sortedArray";
+                case Strategy::ELIAS_FANO: return "eliasFano";
+                case Strategy::RANK_SELECT: return "rankSelect";
+                default: return "none";
+            }
+        }
+
+        /**
+         * All free positions, for building the same mapping with a different strategy.
+         */
+        [[nodiscard]] std::vector<size_t> toVector() const {
+            std::vector<size_t> result(numPositions);
+            for (size_t i = 0; i < numPositions; i++) {
+                result[i] = at(i);
+            }
+            return result;
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return std::visit([&](const auto &r) -> size_t {
+                if constexpr (std::is_same_v<std::decay_t<decltype(r)>, std::monostate>) {
+                    return 0;
+                } else {
+                    return r.getBits();
+                }
+            }, representation);
+        }
+
+        /**
+         * Independent of the strategy, the positions are written in unary coding.
+         */
+        void writeToStream(std::ostream &os) const {
+            std::vector<size_t> freePositions = toVector();
+            size_t bitSize = freePositions.empty() ? 0 : freePositions.size() + freePositions.back() + 1;
+            writeValue<uint64_t>(os, bitSize);
+            std::vector<uint64_t> words((bitSize + 63) / 64);
+            for (size_t i = 0; i < freePositions.size(); i++) {
+                words[(i + freePositions[i]) / 64] |= 1ul << ((i + freePositions[i]) % 64);
+            }
+            writeVector(os, words);
+        }
+
+        void readFromStream(std::istream &is) {
+            size_t bitSize = readValue<uint64_t>(is);
+            std::vector<uint64_t> words = readVector<uint64_t>(is);
+            if (words.size() != (bitSize + 63) / 64) {
+                throw std::invalid_argument("Invalid free positions");
+            }
+            std::vector<size_t> freePositions;
+            for (size_t bit = 0; bit < bitSize; bit++) {
+                if ((words[bit / 64] >> (bit % 64)) & 1) {
+                    freePositions.push_back(bit - freePositions.size());
+                }
+            }
+            build(freePositions);
+        }
+};
+} // namespace consensus
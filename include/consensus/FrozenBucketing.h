@@ -0,0 +1,123 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <algorithm>
+
+#include <bytehamster/util/Function.h>
+
+#include "BumpedKPerfectHashFunction.h"
+
+namespace consensus {
+/**
+ * Query-only copy of the layers of a BumpedKPerfectHashFunction, which gives exactly the same results.
+ * The constants of all layers and the thresholds are stored in one cache-aligned block of words,
+ * with the thresholds widened to 16 bits each.
+ * The layers are unrolled, and the division of the threshold compaction is replaced by a multiplication
+ * with a precomputed reciprocal. Keys that all layers bump are passed to the fallback of the function,
+ * so it must stay alive.
+ */
+template <typename BucketingFunction>
+class FrozenBucketing {
+        static constexpr size_t NUM_LAYERS = BucketingFunction::NUM_LAYERS;
+        static constexpr size_t THRESHOLD_RANGE = BucketingFunction::THRESHOLD_RANGE;
+        static_assert(BucketingFunction::THRESHOLD_BITS <= 16);
+        // Numerators of the compaction, (THRESHOLD_RANGE - 1) * (threshold - minThreshold), have at most 48 bits
+        static constexpr size_t NUMERATOR_BITS = 48;
+        static constexpr size_t WORDS_PER_LAYER = 3;
+        static constexpr size_t THRESHOLDS_PER_WORD = 4;
+        static constexpr size_t CACHE_LINE_BYTES = 64;
+
+        struct FreeDeleter {
+            void operator()(uint64_t *words) const {
+                std::free(words);
+            }
+        };
+
+        const BucketingFunction *function;
+        size_t numLayers;
+        size_t numWords;
+        // Per layer the reciprocal, base and size, minimum threshold and shift, then the thresholds
+        std::unique_ptr<uint64_t[], FreeDeleter> block;
+    public:
+        explicit FrozenBucketing(const BucketingFunction &function)
+                : function(&function), numLayers(function.layerInfo.size() - 1) {
+            size_t numThresholds = function.layerInfo.back().base;
+            size_t thresholdWords = (numThresholds + THRESHOLDS_PER_WORD - 1) / THRESHOLDS_PER_WORD;
+            numWords = NUM_LAYERS * WORDS_PER_LAYER + thresholdWords;
+            size_t bytes = (numWords * sizeof(uint64_t) + CACHE_LINE_BYTES - 1) / CACHE_LINE_BYTES * CACHE_LINE_BYTES;
+            block.reset(static_cast<uint64_t *>(std::aligned_alloc(CACHE_LINE_BYTES, bytes)));
+            if (block == nullptr) {
+                throw std::bad_alloc();
+            }
+            std::fill_n(block.get(), numWords, 0);
+            for (size_t layer = 0; layer < numLayers; layer++) {
+                size_t expected = function.layerInfo[layer].expectedThreshold;
+                uint64_t interpolationRange = std::max(1ul, expected / BucketingFunction::THRESHOLD_TRIMMING);
+                // The quotient is exact for all numerators, see Lemire et al., Faster Remainder by Direct Computation
+                size_t shift = NUMERATOR_BITS + std::bit_width(interpolationRange - 1);
+                uint64_t *constants = block.get() + layer * WORDS_PER_LAYER;
+                constants[0] = uint64_t(((__uint128_t(1) << shift) + interpolationRange - 1) / interpolationRange);
+                constants[1] = function.layerInfo[layer].base
+                        | uint64_t(function.layerInfo[layer + 1].base - function.layerInfo[layer].base) << 32;
+                constants[2] = (expected - expected / BucketingFunction::THRESHOLD_TRIMMING) | uint64_t(shift) << 32;
+                for (size_t i = function.layerInfo[layer].base; i < function.layerInfo[layer + 1].base; i++) {
+                    thresholds()[i / THRESHOLDS_PER_WORD]
+                            |= function.thresholds.at(i) << (16 * (i % THRESHOLDS_PER_WORD));
+                }
+            }
+        }
+
+        [[nodiscard]] size_t getBits() const {
+            return 64 * numWords;
+        }
+
+        [[nodiscard]] inline size_t operator()(uint64_t mhc) const {
+            return evaluateLayer<0>(mhc);
+        }
+
+    private:
+        [[nodiscard]] uint64_t *thresholds() const {
+            return block.get() + NUM_LAYERS * WORDS_PER_LAYER;
+        }
+
+        template <size_t layer>
+        [[nodiscard]] inline size_t evaluateLayer(uint64_t mhc) const {
+            if constexpr (layer == NUM_LAYERS) {
+                return function->evaluateFallback(mhc);
+            } else {
+                if (layer == numLayers) {
+                    return function->evaluateFallback(mhc);
+                }
+                if constexpr (layer != 0) {
+                    mhc = ::bytehamster::util::remix(mhc);
+                }
+                const uint64_t *constants = block.get() + layer * WORDS_PER_LAYER;
+                uint32_t bucket = uint32_t(constants[1])
+                        + ::bytehamster::util::fastrange32(mhc & 0xffffffff, uint32_t(constants[1] >> 32));
+                uint64_t storedThreshold = (thresholds()[bucket / THRESHOLDS_PER_WORD]
+                        >> (16 * (bucket % THRESHOLDS_PER_WORD))) & 0xffff;
+                if (compactThreshold(mhc >> 32, constants) <= storedThreshold) {
+                    return bucket;
+                }
+                return evaluateLayer<layer + 1>(mhc);
+            }
+        }
+
+        /**
+         * Same result as BumpedKPerfectHashFunction::compactThreshold.
+         */
+        [[nodiscard]] static inline uint64_t compactThreshold(uint32_t threshold, const uint64_t *constants) {
+            uint32_t minThreshold = uint32_t(constants[2]);
+            if (threshold < minThreshold) {
+                return 1;
+            }
+            uint64_t numerator = (THRESHOLD_RANGE - 1) * uint64_t(threshold - minThreshold);
+            uint64_t quotient = uint64_t((__uint128_t(numerator) * constants[0]) >> (constants[2] >> 32));
+            return std::min<uint64_t>(THRESHOLD_RANGE - 1, 1 + quotient);
+        }
+};
+} // namespace consensus
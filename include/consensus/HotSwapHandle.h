@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace consensus {
+/**
+ * Holds the current instance of a perfect hash function and replaces it while other threads query it.
+ * Uses epoch-based reclamation: A reader announces the global epoch in its own slot before loading the
+ * instance pointer, so readers never take a lock. Replaced instances are retired with the epoch
+ * after the swap and freed by the writer once no reader announces an older epoch, so readers never
+ * run the destructor of an instance.
+ * The number of concurrent readers is bounded by the number of slots given to the constructor.
+ */
+template <typename Phf>
+class HotSwapHandle {
+    private:
+        static constexpr uint64_t IDLE = std::numeric_limits<uint64_t>::max();
+
+        struct alignas(64) ReaderSlot {
+            std::atomic<uint64_t> epoch = IDLE;
+            std::atomic<bool> registered = false;
+        };
+
+        struct RetiredInstance {
+            uint64_t epoch;
+            std::unique_ptr<Phf> instance;
+        };
+
+        std::atomic<Phf *> current;
+        std::atomic<uint64_t> globalEpoch = 0;
+        std::atomic<size_t> numRetired = 0;
+        std::vector<ReaderSlot> slots;
+        std::mutex writerMutex;
+        std::vector<RetiredInstance> retired;
+    public:
+        class Reader;
+
+        /**
+         * Keeps the instance that was current when pinning alive until the pin goes out of scope.
+         * For query loops, pinning once per batch of keys is faster than once per key.
+         * A reader can only hold one pin at a time.
+         */
+        class Pin {
+                friend class Reader;
+                Reader &reader;
+                const Phf *instance;
+
+                explicit Pin(Reader &reader) : reader(reader) {
+                    ReaderSlot &slot = reader.handle.slots[reader.slot];
+                    // Must be visible before loading the pointer, so the default sequential consistency
+                    slot.epoch.store(reader.handle.globalEpoch.load());
+                    instance = reader.handle.current.load();
+                }
+            public:
+                Pin(const Pin &) = delete;
+                Pin &operator=(const Pin &) = delete;
+
+                ~Pin() {
+                    reader.handle.slots[reader.slot].epoch.store(IDLE, std::memory_order_release);
+                }
+
+                const Phf &operator*() const {
+                    return *instance;
+                }
+
+                const Phf *operator->() const {
+                    return instance;
+                }
+        };
+
+        /**
+         * A registered query thread. Each thread needs its own reader.
+         */
+        class Reader {
+                friend class HotSwapHandle;
+                friend class Pin;
+                HotSwapHandle &handle;
+                size_t slot;
+
+                Reader(HotSwapHandle &handle, size_t slot) : handle(handle), slot(slot) {
+                }
+            public:
+                Reader(const Reader &) = delete;
+                Reader &operator=(const Reader &) = delete;
+
+                ~Reader() {
+                    handle.slots[slot].registered.store(false, std::memory_order_release);
+                }
+
+                [[nodiscard]] Pin pin() {
+                    return Pin(*this);
+                }
+
+                template <typename Key>
+                [[nodiscard]] size_t operator()(const Key &key) {
+                    Pin p(*this);
+                    return p->operator()(key);
+                }
+        };
+
+        HotSwapHandle(std::unique_ptr<Phf> initial, size_t maxReaders)
+                : current(initial.release()), slots(maxReaders) {
+        }
+
+        HotSwapHandle(const HotSwapHandle &) = delete;
+        HotSwapHandle &operator=(const HotSwapHandle &) = delete;
+
+        /**
+         * All readers must be destroyed before the handle.
+         */
+        ~HotSwapHandle() {
+            delete current.load();
+        }
+
+        [[nodiscard]] Reader registerReader() {
+            for (size_t i = 0; i < slots.size(); i++) {
+                bool expected = false;
+                if (slots[i].registered.compare_exchange_strong(expected, true)) {
+                    return Reader(*this, i);
+                }
+            }
+            throw std::runtime_error("All reader slots are in use");
+        }
+
+        /**
+         * Make a newly built or loaded instance visible to all readers.
+         * Queries that already started continue on the previous instance. It is freed by this or a later
+         * call to publish or tryCollect after they finish.
+         */
+        void publish(std::unique_ptr<Phf> next) {
+            std::lock_guard lock(writerMutex);
+            Phf *previous = current.exchange(next.release());
+            uint64_t epoch = globalEpoch.fetch_add(1) + 1;
+            retired.push_back(RetiredInstance{ epoch, std::unique_ptr<Phf>(previous) });
+            numRetired.store(retired.size(), std::memory_order_relaxed);
+            collect();
+        }
+
+        /**
+         * Free retired instances that no reader uses anymore, unless another thread is currently doing that.
+         * Readers never call this. Call it from the writer or a reclaimer thread to free the previous
+         * instance without waiting for the next publish.
+         */
+        void tryCollect() {
+            std::unique_lock lock(writerMutex, std::try_to_lock);
+            if (lock.owns_lock()) {
+                collect();
+            }
+        }
+
+        [[nodiscard]] size_t retiredInstances() const {
+            return numRetired.load(std::memory_order_relaxed);
+        }
+
+    private:
+        /**
+         * A reader announcing epoch e loaded the pointer after all swaps with epoch <= e,
+         * so instances retired with an epoch larger than e might still be used by it.
+         */
+        void collect() {
+            uint64_t oldestAnnounced = IDLE;
+            for (const ReaderSlot &slot : slots) {
+                oldestAnnounced = std::min(oldestAnnounced, slot.epoch.load());
+            }
+            std::erase_if(retired, [&](const RetiredInstance &instance) {
+                return instance.epoch <= oldestAnnounced;
+            });
+            numRetired.store(retired.size(), std::memory_order_relaxed);
+        }
+};
+} // namespace consensus
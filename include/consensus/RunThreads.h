@@ -0,0 +1,38 @@
+#pragma once
+
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace consensus {
+/**
+ * Runs the function on the given number of threads, including the calling one, and rethrows the first exception.
+ */
+template <typename Function>
+void runThreads(size_t numThreads, Function function) {
+    std::exception_ptr exception;
+    std::mutex exceptionMutex;
+    auto run = [&] {
+        try {
+            function();
+        } catch (...) {
+            std::lock_guard lock(exceptionMutex);
+            if (!exception) {
+                exception = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; i++) {
+        threads.emplace_back(run);
+    }
+    run();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+} // namespace consensus
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+
+namespace consensus {
+/**
+ * Memory resource for the temporary buffers of many consecutive constructions, see ConstructionOptions::scratch.
+ * Allocations are taken from a single buffer and are only freed all at once by <code>reset</code>.
+ * Allocations that do not fit go to the upstream resource, and the next reset grows the buffer
+ * to the peak demand, so after the first few constructions there are no more heap allocations.
+ * Not thread-safe, each thread needs its own arena.
+ */
+class ScratchArena : public std::pmr::memory_resource {
+        std::pmr::memory_resource *upstream;
+        std::unique_ptr<std::byte[]> buffer;
+        size_t capacity = 0;
+        size_t used = 0;
+        // Bytes that the buffer would have needed since the last reset, including the ones from upstream
+        size_t demand = 0;
+    public:
+        explicit ScratchArena(std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+                : upstream(upstream) {
+        }
+
+        ScratchArena(const ScratchArena &) = delete;
+        ScratchArena &operator=(const ScratchArena &) = delete;
+
+        /**
+         * Frees everything that was allocated from the buffer. All allocations must already be deallocated.
+         */
+        void reset() {
+            if (demand > capacity) {
+                capacity = demand + demand / 4;
+                buffer = std::make_unique_for_overwrite<std::byte[]>(capacity);
+            }
+            used = 0;
+            demand = 0;
+        }
+
+        [[nodiscard]] size_t getCapacity() const {
+            return capacity;
+        }
+
+    private:
+        void *do_allocate(size_t bytes, size_t alignment) override {
+            demand += bytes + alignment;
+            if (bytes > 0 && alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+                void *position = buffer.get() + used;
+                size_t space = capacity - used;
+                if (std::align(alignment, bytes, position, space) != nullptr) {
+                    used = capacity - space + bytes;
+                    return position;
+                }
+            }
+            return upstream->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void *pointer, size_t bytes, size_t alignment) override {
+            std::less<const void *> less;
+            if (less(pointer, buffer.get()) || !less(pointer, buffer.get() + capacity)) {
+                upstream->deallocate(pointer, bytes, alignment);
+            }
+        }
+
+        [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+            return this == &other;
+        }
+};
+} // namespace consensus
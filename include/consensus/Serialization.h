@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace consensus {
+/**
+ * Minimal helpers for writing the data structures to binary streams.
+ * The format uses the native byte order and is not meant to be portable between architectures.
+ */
+template <typename T>
+void writeValue(std::ostream &os, const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+T readValue(std::istream &is) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    is.read(reinterpret_cast<char *>(&value), sizeof(T));
+    if (!is) {
+        throw std::runtime_error("Unexpected end of stream");
+    }
+    return value;
+}
+
+template <typename T>
+void writeVector(std::ostream &os, const std::vector<T> &vector) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    writeValue<uint64_t>(os, vector.size());
+    os.write(reinterpret_cast<const char *>(vector.data()), std::streamsize(vector.size() * sizeof(T)));
+}
+
+template <typename T>
+std::vector<T> readVector(std::istream &is) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::vector<T> vector(readValue<uint64_t>(is));
+    is.read(reinterpret_cast<char *>(vector.data()), std::streamsize(vector.size() * sizeof(T)));
+    if (!is) {
+        throw std::runtime_error("Unexpected end of stream");
+    }
+    return vector;
+}
+} // namespace consensus
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <bytehamster/util/Function.h>
+
+namespace consensus {
+/**
+ * Split functions decide for a key and a seed whether the key goes to the left child of a splitting task.
+ * The seed is transformed once per trial with hashSeed, so that toLeft is all that is evaluated per key.
+ * Keys are already hash values, so the policies do not need to hash them again.
+ * The ID is stored when serializing, so that instances are only loaded with the same split function.
+ */
+struct RemixSplitHash {
+    static constexpr uint64_t ID = 0;
+    static constexpr const char *NAME = "remix";
+
+    [[nodiscard]] static inline uint64_t hashSeed(uint64_t seed) {
+        return seed;
+    }
+
+    [[nodiscard]] static inline bool toLeft(uint64_t key, uint64_t hashedSeed) {
+        return bytehamster::util::remix(key + hashedSeed) % 2;
+    }
+};
+
+/**
+ * Multiply-shift: The highest bit of the key times a random odd multiplier.
+ * Each trial only costs a multiplication per key, instead of the multiplications and shifts of remix.
+ */
+struct MultiplyShiftSplitHash {
+    static constexpr uint64_t ID = 1;
+    static constexpr const char *NAME = "multiplyShift";
+
+    [[nodiscard]] static inline uint64_t hashSeed(uint64_t seed) {
+        return bytehamster::util::remix(seed) | 1;
+    }
+
+    [[nodiscard]] static inline bool toLeft(uint64_t key, uint64_t hashedSeed) {
+        return (key * hashedSeed) >> 63;
+    }
+};
+} // namespace consensus
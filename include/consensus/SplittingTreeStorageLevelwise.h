@@ -3,14 +3,13 @@
 #include <array>
 #include <cstddef>
 #include <cmath>
+#include <stdexcept>
+#include <type_traits>
 
 #include "UnalignedBitVector.h"
 
 namespace consensus {
 
-template <size_t n, double overhead>
-class SplittingTreeStorageQueryOptimized;
-
 // sage: print(0, [N(log((2**(2**i))/binomial(2**i, (2**i)/2), 2)) for i in [1..20]], sep=', ')
 constexpr std::array<double, 21> optimalBitsForSplit = {0, 1.00000000000000, 1.41503749927884, 1.87071698305503,
             2.34827556689194, 2.83701728740494, 3.33138336299656, 3.82856579982622, 4.32715694302912, 4.82645250522622,
@@ -21,17 +20,26 @@ static constexpr size_t intLog2(size_t x) {
     return std::bit_width(x) - 1;
 }
 
+/**
+ * Passing this as overhead template parameter makes the overhead a constructor argument instead,
+ * so that the layout of the seeds is computed at runtime. See OverheadBudget.
+ */
+constexpr double RUNTIME_OVERHEAD = 0;
+
 /**
  * Calculates the storage positions of splits in the splitting tree.
  * The storage has to be in the same order as the search for consensus to work.
+ * Usually evaluated at compile time, see OverheadBudget.
  */
-template <size_t n, double overhead>
-class SplittingTreeStorageLevelwise {
+template <size_t n>
+class LevelwiseLayout {
     private:
-        friend class SplittingTreeStorageQueryOptimized<n, overhead>;
+        template <size_t>
+        friend class QueryOptimizedLayout;
         static constexpr size_t logn = intLog2(n);
+        std::array<size_t, logn> microBitsForSplitOnLevelLookup = {};
 
-        static constexpr size_t microBitsForSplitOnLevel(size_t level) {
+        static constexpr size_t microBitsForSplitOnLevel(size_t level, double overhead) {
             // MicroBits instead of double to avoid rounding inconsistencies and for much faster evaluation
             double bits = optimalBitsForSplit[logn - level];
             // "Textbook" Consensus would just add the overhead here.
@@ -41,26 +49,65 @@ class SplittingTreeStorageLevelwise {
             return std::ceil(1024.0 * 1024.0 * bits);
         }
 
-        static constexpr std::array<size_t, logn> fillMicroBitsForSplitLookup() {
-            std::array<size_t, logn> array;
+    public:
+        constexpr explicit LevelwiseLayout(double overhead) {
             for (size_t level = 0; level < logn; level++) {
-                array[level] = microBitsForSplitOnLevel(level);
+                microBitsForSplitOnLevelLookup[level] = microBitsForSplitOnLevel(level, overhead);
             }
-            return array;
         }
 
-        static constexpr std::array<size_t, logn> microBitsForSplitOnLevelLookup = fillMicroBitsForSplitLookup();
-
-    public:
-        static size_t seedStartPosition(size_t level, size_t index) {
+        constexpr size_t seedStartPosition(size_t level, size_t index) const {
             return (microBitsForSplitOnLevelLookup[level] * index) / (1024 * 1024);
         }
 };
 
-template <size_t k, double overhead, size_t level>
+/**
+ * Layout of the seeds for a compile-time overhead. Empty, so that it does not need space in the hash function,
+ * and the compiler can evaluate the layout.
+ */
+template <typename Layout, double overhead>
+struct CompileTimeOverheadBudget {
+    static constexpr Layout layout{overhead};
+
+    constexpr explicit CompileTimeOverheadBudget(double runtimeOverhead = overhead) {
+        if (runtimeOverhead != overhead) {
+            throw std::invalid_argument("The overhead is fixed at compile time");
+        }
+    }
+
+    [[nodiscard]] static constexpr double getOverhead() {
+        return overhead;
+    }
+};
+
+/**
+ * Layout of the seeds for an overhead that is only known at runtime.
+ */
+template <typename Layout>
+struct RuntimeOverheadBudget {
+    double overhead;
+    Layout layout;
+
+    explicit RuntimeOverheadBudget(double overhead) : overhead(overhead), layout(overhead) {
+        if (!(overhead > 0)) {
+            throw std::invalid_argument("The overhead must be positive");
+        }
+    }
+
+    [[nodiscard]] double getOverhead() const {
+        return overhead;
+    }
+};
+
+template <typename Layout, double overhead>
+using OverheadBudget = std::conditional_t<overhead == RUNTIME_OVERHEAD,
+        RuntimeOverheadBudget<Layout>, CompileTimeOverheadBudget<Layout, overhead>>;
+
+template <size_t k, size_t level>
 struct SplittingTaskIteratorLevelwise {
     static constexpr size_t logk = intLog2(k);
     static constexpr size_t taskSize = 1ul << (logk - level);
+    const LevelwiseLayout<k> &layout;
     size_t idx;
     UnalignedBitVector &unalignedBitVector;
     size_t seedEndPos = 0;
@@ -70,15 +117,15 @@ struct SplittingTaskIteratorLevelwise {
     size_t fromKey = 0;
     uint64_t maxSeed = 0;
 
-    explicit SplittingTaskIteratorLevelwise(size_t currentTask, UnalignedBitVector &unalignedBitVector)
-            : idx(currentTask), unalignedBitVector(unalignedBitVector) {
+    SplittingTaskIteratorLevelwise(const LevelwiseLayout<k> &layout, size_t currentTask, UnalignedBitVector &unalignedBitVector)
+            : layout(layout), idx(currentTask), unalignedBitVector(unalignedBitVector) {
         recalculatePositions();
         readSeed();
     }
 
     void recalculatePositions() {
-        size_t seedStartPos = SplittingTreeStorageLevelwise<k, overhead>::seedStartPosition(level, idx);
-        seedEndPos = SplittingTreeStorageLevelwise<k, overhead>::seedStartPosition(level, idx + 1);
+        size_t seedStartPos = layout.seedStartPosition(level, idx);
+        seedEndPos = layout.seedStartPosition(level, idx + 1);
         seedWidth = seedEndPos - seedStartPos;
         seedMask = (1ul << seedWidth) - 1;
         fromKey = idx * taskSize;
@@ -12,14 +12,17 @@ namespace consensus {
 /**
  * Calculates the storage positions of splits in the splitting tree.
  * The storage has to be in the same order as the search for consensus to work.
+ * Usually evaluated at compile time, see OverheadBudget.
  */
-template <size_t n, double overhead>
-class SplittingTreeStorageQueryOptimized {
+template <size_t n>
+class QueryOptimizedLayout {
     private:
         static constexpr size_t logn = intLog2(n);
-        static constexpr auto microBitsForSplitOnLevelLookup = SplittingTreeStorageLevelwise<n, overhead>::microBitsForSplitOnLevelLookup;
+        std::array<size_t, logn> microBitsForSplitOnLevelLookup = {};
+        std::array<size_t, logn> microBitsForFirstSplitOnLevelLookup = {};
+        std::array<size_t, logn + 1> microBitsLevelSize = {};
 
-        static constexpr size_t microBitsForFirstSplitOnLevel(size_t level) {
+        constexpr size_t microBitsForFirstSplitOnLevel(size_t level) const {
             if (level == 0) { // Root
                 return microBitsForSplitOnLevelLookup[0]
                         - std::min(logn * 750000ul, microBitsForSplitOnLevelLookup[0]);
@@ -27,32 +30,22 @@ class SplittingTreeStorageQueryOptimized {
             return microBitsForSplitOnLevelLookup[level] + 750000ul;
         }
 
-        static constexpr std::array<size_t, logn> fillMicroBitsForFirstSplitLookup() {
-            std::array<size_t, logn> array;
+    public:
+        constexpr explicit QueryOptimizedLayout(double overhead)
+                : microBitsForSplitOnLevelLookup(LevelwiseLayout<n>(overhead).microBitsForSplitOnLevelLookup) {
             for (size_t level = 0; level < logn; level++) {
-                array[level] = microBitsForFirstSplitOnLevel(level);
+                microBitsForFirstSplitOnLevelLookup[level] = microBitsForFirstSplitOnLevel(level);
             }
-            return array;
-        }
-
-        static constexpr std::array<size_t, logn> microBitsForFirstSplitOnLevelLookup = fillMicroBitsForFirstSplitLookup();
-
-        static constexpr std::array<size_t, logn + 1> fillMicroBitsLevelSize() {
-            std::array<size_t, logn + 1> array;
             size_t microBits = 0;
             for (size_t level = 0; level < logn; level++) {
-                array[level] = microBits;
+                microBitsLevelSize[level] = microBits;
                 size_t ntasks = (1ul << level);
                 microBits += microBitsForSplitOnLevelLookup[level] * (ntasks - 1) + microBitsForFirstSplitOnLevelLookup[level];
             }
-            array[logn] = microBits;
-            return array;
+            microBitsLevelSize[logn] = microBits;
         }
 
-        static constexpr std::array<size_t, logn + 1> microBitsLevelSize = fillMicroBitsLevelSize();
-
-    public:
-        static size_t seedStartPosition(size_t level, size_t index) {
+        constexpr size_t seedStartPosition(size_t level, size_t index) const {
             size_t microBits = microBitsLevelSize[level];
             if (index > 0) {
                 microBits += microBitsForSplitOnLevelLookup[level] * (index - 1)
@@ -61,9 +54,24 @@ class SplittingTreeStorageQueryOptimized {
             return microBits / (1024 * 1024);
         }
 
-        static constexpr size_t totalSize() {
+        constexpr size_t totalSize() const {
             return microBitsLevelSize[logn] / (1024 * 1024);
         }
+
+        /**
+         * Inputs of seedStartPosition in units of 2^-20 bits, for representations that evaluate it themselves.
+         */
+        constexpr size_t microBitsBeforeLevel(size_t level) const {
+            return microBitsLevelSize[level];
+        }
+
+        constexpr size_t microBitsForSplit(size_t level) const {
+            return microBitsForSplitOnLevelLookup[level];
+        }
+
+        constexpr size_t microBitsForFirstSplit(size_t level) const {
+            return microBitsForFirstSplitOnLevelLookup[level];
+        }
 };
 
 /**
@@ -71,11 +79,11 @@ class SplittingTreeStorageQueryOptimized {
  * Calculates the order in which to search tasks (and their storage location).
  * The storage has to be in the same order as the search for consensus to work.
  */
-template <size_t n, double overhead>
+template <size_t n>
 struct SplittingTaskIteratorQueryOptimized {
     static constexpr size_t logn = intLog2(n);
-    using TreeStorage = SplittingTreeStorageQueryOptimized<n, overhead>;
 
+    const QueryOptimizedLayout<n> &layout;
     size_t level;
     size_t index;
     size_t bucket;
@@ -86,19 +94,20 @@ struct SplittingTaskIteratorQueryOptimized {
     size_t seedWidth = 0;
     uint64_t seedMask = 0;
 
-    SplittingTaskIteratorQueryOptimized(size_t level, size_t index, size_t bucket, size_t nbuckets)
-            : level(level), index(index), bucket(bucket), nbuckets(nbuckets) {
+    SplittingTaskIteratorQueryOptimized(const QueryOptimizedLayout<n> &layout,
+                                        size_t level, size_t index, size_t bucket, size_t nbuckets)
+            : layout(layout), level(level), index(index), bucket(bucket), nbuckets(nbuckets) {
         updateProperties();
     }
 
     void updateProperties() {
         taskSizeThisLevel = 1ul << (logn - level);
         tasksThisLevel = n / taskSizeThisLevel;
-        size_t startPosition = bucket * TreeStorage::totalSize() + TreeStorage::seedStartPosition(level, index);
+        size_t startPosition = bucket * layout.totalSize() + layout.seedStartPosition(level, index);
         if (index + 1 < tasksThisLevel) {
-            endPosition = bucket * TreeStorage::totalSize() + TreeStorage::seedStartPosition(level, index + 1);
+            endPosition = bucket * layout.totalSize() + layout.seedStartPosition(level, index + 1);
         } else {
-            endPosition = bucket * TreeStorage::totalSize() + TreeStorage::seedStartPosition(level + 1, 0);
+            endPosition = bucket * layout.totalSize() + layout.seedStartPosition(level + 1, 0);
         }
         seedWidth = endPosition - startPosition;
         seedMask = ((1ul << seedWidth) - 1);
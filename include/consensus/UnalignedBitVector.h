@@ -3,6 +3,9 @@
 #include <vector>
 #include <cstdint>
 #include <iomanip>
+#include <span>
+
+#include "Serialization.h"
 
 namespace consensus {
 /**
@@ -27,6 +30,13 @@ class UnalignedBitVector {
          * The bit position refers to the right-most bit to read.
          */
         [[nodiscard]] inline uint64_t readAt(size_t bitPosition) const {
+            return readAt(bits, bitPosition);
+        }
+
+        /**
+         * Read from the words of a bit vector that is stored elsewhere, see <code>words</code>.
+         */
+        [[nodiscard]] static inline uint64_t readAt(std::span<const uint64_t> bits, size_t bitPosition) {
             assert(bitPosition / 64 <= bits.size());
             if (bitPosition % 64 == 0) {
                 return bits[(bitPosition / 64)];
@@ -59,10 +69,23 @@ class UnalignedBitVector {
         void inline writeRootSeed(uint64_t value) {
             bits[0] = value;
         }
+
+        [[nodiscard]] std::span<const uint64_t> words() const {
+            return bits;
+        }
+
         [[nodiscard]] size_t bitSize() const {
             return bits.size() * 64;
         }
 
+        void writeToStream(std::ostream &os) const {
+            writeVector(os, bits);
+        }
+
+        void readFromStream(std::istream &is) {
+            bits = readVector<uint64_t>(is);
+        }
+
         void print() const {
             for (uint64_t val : bits) {
                 std::cout << std::setfill('0') << std::setw(16) << std::right << std::hex << val << " ";
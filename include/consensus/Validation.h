@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "RunThreads.h"
+
+namespace consensus {
+/**
+ * Keys of one chunk of the input. Sources either point <code>keys</code> to memory they own
+ * or fill <code>storage</code>, for example after reading <code>buffer</code> from a file.
+ */
+struct KeyChunk {
+    size_t firstIndex = 0;
+    std::span<const uint64_t> keys;
+    std::vector<uint64_t> storage;
+    std::vector<char> buffer;
+};
+
+/**
+ * Key source for keys that are already in memory, for example to check a function directly after construction.
+ */
+class SpanKeySource {
+        static constexpr size_t CHUNK_SIZE = 1ul << 16;
+        std::span<const uint64_t> keys;
+        std::atomic<size_t> position = 0;
+    public:
+        explicit SpanKeySource(std::span<const uint64_t> keys) : keys(keys) {
+        }
+
+        bool next(KeyChunk &chunk) {
+            size_t begin = position.fetch_add(CHUNK_SIZE, std::memory_order_relaxed);
+            if (begin >= keys.size()) {
+                return false;
+            }
+            chunk.firstIndex = begin;
+            chunk.keys = keys.subspan(begin, std::min(CHUNK_SIZE, keys.size() - begin));
+            return true;
+        }
+
+        void rewind() {
+            position = 0;
+        }
+};
+
+struct Collision {
+    size_t position = 0;
+    // Indices in the input of all keys mapped to the position
+    std::vector<size_t> keyIndices;
+};
+
+struct ValidationResult {
+    size_t expectedKeys = 0;
+    size_t numKeys = 0;
+    size_t outOfRange = 0;
+    // Keys that were mapped to a position that another key was mapped to before
+    size_t collisions = 0;
+    std::vector<size_t> firstOutOfRange;
+    std::vector<Collision> firstCollisions;
+    std::chrono::steady_clock::duration duration{};
+
+    /**
+     * Whether the keys are mapped to [0, expectedKeys) without collisions and without leaving a position empty.
+     */
+    [[nodiscard]] bool isMinimalPerfect() const {
+        return numKeys == expectedKeys && outOfRange == 0 && collisions == 0;
+    }
+
+    [[nodiscard]] double keysPerSecond() const {
+        return double(numKeys) / std::chrono::duration<double>(duration).count();
+    }
+};
+
+/**
+ * Checks that a perfect hash function that was built for <code>expectedKeys</code> keys is minimal
+ * and collision-free on the keys of the source. The threads read chunks of keys from the source
+ * and mark the positions in a shared bitmap. This only needs expectedKeys bits in addition to the chunks,
+ * so the keys can be streamed from a file.
+ * If there are collisions, a second pass over the source finds all keys of the first
+ * <code>maxReported</code> colliding positions.
+ *
+ * The source needs the thread-safe method <code>bool next(KeyChunk &)</code>,
+ * which returns false at the end of the input, and <code>rewind()</code>, see SpanKeySource.
+ */
+template <typename Phf, typename KeySource>
+ValidationResult validate(const Phf &phf, size_t expectedKeys, KeySource &source,
+                          size_t numThreads = std::thread::hardware_concurrency(), size_t maxReported = 10) {
+    ValidationResult result;
+    result.expectedKeys = expectedKeys;
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::atomic<uint64_t>> taken((expectedKeys + 63) / 64);
+    std::vector<std::pair<size_t, size_t>> collidingKeys; // Key index, position
+    std::mutex resultMutex;
+
+    auto markPositions = [&] {
+        KeyChunk chunk;
+        size_t numKeys = 0;
+        size_t outOfRange = 0;
+        size_t collisions = 0;
+        std::vector<size_t> firstOutOfRange;
+        std::vector<std::pair<size_t, size_t>> firstColliding;
+        while (source.next(chunk)) {
+            numKeys += chunk.keys.size();
+            for (size_t i = 0; i < chunk.keys.size(); i++) {
+                size_t position = phf(chunk.keys[i]);
+                if (position >= expectedKeys) {
+                    outOfRange++;
+                    if (firstOutOfRange.size() < maxReported) {
+                        firstOutOfRange.push_back(chunk.firstIndex + i);
+                    }
+                    continue;
+                }
+                uint64_t mask = 1ul << (position % 64);
+                if (taken[position / 64].fetch_or(mask, std::memory_order_relaxed) & mask) {
+                    collisions++;
+                    if (firstColliding.size() < maxReported) {
+                        firstColliding.emplace_back(chunk.firstIndex + i, position);
+                    }
+                }
+            }
+        }
+        std::lock_guard lock(resultMutex);
+        result.numKeys += numKeys;
+        result.outOfRange += outOfRange;
+        result.collisions += collisions;
+        result.firstOutOfRange.insert(result.firstOutOfRange.end(), firstOutOfRange.begin(), firstOutOfRange.end());
+        collidingKeys.insert(collidingKeys.end(), firstColliding.begin(), firstColliding.end());
+    };
+    runThreads(std::max(numThreads, 1ul), markPositions);
+
+    std::sort(result.firstOutOfRange.begin(), result.firstOutOfRange.end());
+    result.firstOutOfRange.resize(std::min(result.firstOutOfRange.size(), maxReported));
+    std::sort(collidingKeys.begin(), collidingKeys.end());
+    collidingKeys.resize(std::min(collidingKeys.size(), maxReported));
+    if (!collidingKeys.empty()) {
+        std::vector<size_t> positions;
+        for (auto [keyIndex, position] : collidingKeys) {
+            positions.push_back(position);
+        }
+        std::sort(positions.begin(), positions.end());
+        positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+        result.firstCollisions.resize(positions.size());
+        for (size_t i = 0; i < positions.size(); i++) {
+            result.firstCollisions[i].position = positions[i];
+        }
+        source.rewind();
+        runThreads(std::max(numThreads, 1ul), [&] {
+            KeyChunk chunk;
+            while (source.next(chunk)) {
+                for (size_t i = 0; i < chunk.keys.size(); i++) {
+                    size_t position = phf(chunk.keys[i]);
+                    auto it = std::lower_bound(positions.begin(), positions.end(), position);
+                    if (it != positions.end() && *it == position) {
+                        std::lock_guard lock(resultMutex);
+                        result.firstCollisions[it - positions.begin()].keyIndices.push_back(chunk.firstIndex + i);
+                    }
+                }
+            }
+        });
+        for (Collision &collision : result.firstCollisions) {
+            std::sort(collision.keyIndices.begin(), collision.keyIndices.end());
+        }
+    }
+    result.duration = std::chrono::steady_clock::now() - begin;
+    return result;
+}
+
+} // namespace consensus
@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+"""
+Runs a benchmark binary over a grid of arguments, stores the RESULT lines together with
+information about the machine and build, and compares the results against a stored baseline.
+
+  ./benchmark.py run --binary ./Benchmark --grid grid.txt --repeats 5 --seed 42 --output results.json
+  ./benchmark.py run ... --baseline baseline.json
+  ./benchmark.py compare baseline.json results.json --time-threshold 0.05
+
+Each line of the grid file holds the arguments of one configuration, empty lines and lines starting
+with # are ignored. Use the same seed for the baseline and the comparison, so that both runs measure
+the same inputs. Comparing exits with status 1 if a metric got worse by more than its threshold.
+"""
+
+import argparse
+import csv
+import datetime
+import json
+import os
+import platform
+import re
+import shlex
+import socket
+import statistics
+import subprocess
+import sys
+
+# Metrics and whether they are times (relative noise is larger than for space)
+METRICS = {
+    "constructionTimeMilliseconds": True,
+    "queryTimeMilliseconds": True,
+    "batchedQueryTimeMilliseconds": True,
+    "hashingTimeMilliseconds": True,
+    "bitsPerElement": False,
+}
+
+
+def parse_result_line(line):
+    result = {}
+    for token in line.split()[1:]:
+        key, _, value = token.partition("=")
+        try:
+            result[key] = float(value)
+        except ValueError:
+            result[key] = value
+    return result
+
+
+def command_output(command):
+    try:
+        return subprocess.run(command, capture_output=True, text=True, check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def cpu_model():
+    try:
+        with open("/proc/cpuinfo") as cpuinfo:
+            for line in cpuinfo:
+                if line.startswith("model name"):
+                    return line.split(":", 1)[1].strip()
+    except OSError:
+        pass
+    return platform.processor() or None
+
+
+def compiler_flags(binary):
+    """Command line recorded by -frecord-gcc-switches, which the benchmark targets are built with."""
+    output = command_output(["readelf", "-p", ".GCC.command.line", binary])
+    if not output:
+        return None
+    flags = re.findall(r"\]\s+(.*)", output)
+    return " ".join(flags) if flags else None
+
+
+def metadata(binary):
+    repository = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    commit = command_output(["git", "-C", repository, "rev-parse", "HEAD"])
+    dirty = command_output(["git", "-C", repository, "status", "--porcelain", "--untracked-files=no"])
+    return {
+        "date": datetime.datetime.now(datetime.timezone.utc).isoformat(),
+        "host": socket.gethostname(),
+        "cpu": cpu_model(),
+        "cores": os.cpu_count(),
+        "kernel": platform.release(),
+        "binary": os.path.abspath(binary),
+        "compilerFlags": compiler_flags(binary),
+        "commit": commit,
+        "dirty": bool(dirty),
+    }
+
+
+def read_grid(arguments):
+    configurations = list(arguments.args or [])
+    if arguments.grid:
+        with open(arguments.grid) as grid:
+            for line in grid:
+                line = line.strip()
+                if line and not line.startswith("#"):
+                    configurations.append(line)
+    return configurations or [""]
+
+
+def run_benchmarks(arguments):
+    runs = []
+    for configuration in read_grid(arguments):
+        for repeat in range(arguments.repeats):
+            command = [arguments.binary] + shlex.split(configuration) + shlex.split(arguments.common)
+            if arguments.seed is not None:
+                command += ["--seed", str(arguments.seed + repeat)]
+            print("Running " + " ".join(command), file=sys.stderr)
+            process = subprocess.run(command, capture_output=True, text=True)
+            if process.returncode != 0:
+                sys.stderr.write(process.stdout + process.stderr)
+                raise SystemExit("Benchmark failed: " + " ".join(command))
+            for line in process.stdout.splitlines():
+                if line.startswith("RESULT"):
+                    runs.append({"configuration": configuration, "repeat": repeat,
+                                 "result": parse_result_line(line)})
+    return runs
+
+
+def run_key(run):
+    """Runs with the same arguments and the same method belong together, even if a binary prints several results."""
+    return run["configuration"] + " | " + str(run["result"].get("method", "")) \
+        + " " + " ".join(f"{key}={value}" for key, value in sorted(run["result"].items())
+                         if key not in METRICS and key not in ("seed", "N", "method") and isinstance(value, str))
+
+
+def summarize(runs):
+    groups = {}
+    for run in runs:
+        groups.setdefault(run_key(run), []).append(run["result"])
+    summary = {}
+    for key, results in groups.items():
+        metrics = {}
+        for metric in METRICS:
+            values = [result[metric] for result in results if isinstance(result.get(metric), float)]
+            if values:
+                metrics[metric] = {
+                    "median": statistics.median(values),
+                    "min": min(values),
+                    "max": max(values),
+                    "stdev": statistics.stdev(values) if len(values) > 1 else 0.0,
+                }
+        summary[key] = {"repeats": len(results), "metrics": metrics}
+    return summary
+
+
+def write_results(path, file_format, meta, runs):
+    if file_format == "json":
+        with open(path, "w") as output:
+            json.dump({"metadata": meta, "runs": runs, "summary": summarize(runs)}, output, indent=2)
+        return
+    fields = sorted({key for run in runs for key in run["result"]})
+    with open(path, "w", newline="") as output:
+        for key, value in meta.items():
+            output.write(f"# {key}: {value}\n")
+        writer = csv.writer(output)
+        writer.writerow(["configuration", "repeat"] + fields)
+        for run in runs:
+            writer.writerow([run["configuration"], run["repeat"]] + [run["result"].get(field, "") for field in fields])
+
+
+def load_summary(path):
+    with open(path) as baseline:
+        data = json.load(baseline)
+    return data.get("summary") or summarize(data["runs"])
+
+
+def compare(baseline, current, time_threshold, space_threshold):
+    regressions = 0
+    for key, entry in current.items():
+        if key not in baseline:
+            print(f"new      {key}")
+            continue
+        for metric, values in entry["metrics"].items():
+            if metric not in baseline[key]["metrics"]:
+                continue
+            old = baseline[key]["metrics"][metric]["median"]
+            new = values["median"]
+            if old == 0:
+                continue
+            change = (new - old) / old
+            threshold = time_threshold if METRICS[metric] else space_threshold
+            status = "ok"
+            if change > threshold:
+                status = "REGRESSION"
+                regressions += 1
+            elif change < -threshold:
+                status = "improved"
+            print(f"{status:10} {key}: {metric} {old:g} -> {new:g} ({change:+.1%})")
+    for key in baseline:
+        if key not in current:
+            print(f"missing  {key}")
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    subparsers = parser.add_subparsers(dest="command", required=True)
+    thresholds = argparse.ArgumentParser(add_help=False)
+    thresholds.add_argument("--time-threshold", type=float, default=0.05,
+                            help="Relative slowdown of a median time that counts as regression")
+    thresholds.add_argument("--space-threshold", type=float, default=0.005,
+                            help="Relative increase of the median bits per key that counts as regression")
+
+    run = subparsers.add_parser("run", parents=[thresholds], help="Run the benchmarks and store the results")
+    run.add_argument("--binary", default="./Benchmark")
+    run.add_argument("--grid", help="File with the arguments of one configuration per line")
+    run.add_argument("--args", action="append", help="Arguments of a configuration, can be repeated")
+    run.add_argument("--common", default="", help="Arguments appended to all configurations")
+    run.add_argument("--repeats", type=int, default=3)
+    run.add_argument("--seed", type=int, help="Pass --seed, incremented for each repeat")
+    run.add_argument("--format", choices=["json", "csv"], default="json")
+    run.add_argument("--output", default="results.json")
+    run.add_argument("--baseline", help="JSON results to compare against after running")
+
+    comparison = subparsers.add_parser("compare", parents=[thresholds], help="Compare two stored JSON results")
+    comparison.add_argument("baseline")
+    comparison.add_argument("current")
+
+    arguments = parser.parse_args()
+    if arguments.command == "run":
+        meta = metadata(arguments.binary)
+        runs = run_benchmarks(arguments)
+        write_results(arguments.output, arguments.format, meta, runs)
+        print(f"Wrote {len(runs)} results to {arguments.output}", file=sys.stderr)
+        if not arguments.baseline:
+            return 0
+        current = summarize(runs)
+        baseline = load_summary(arguments.baseline)
+    else:
+        current = load_summary(arguments.current)
+        baseline = load_summary(arguments.baseline)
+    regressions = compare(baseline, current, arguments.time_threshold, arguments.space_threshold)
+    print(f"{regressions} regressions", file=sys.stderr)
+    return 1 if regressions > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,22 @@
+#!/bin/bash
+# Runs a sharded construction on a single machine, using one process per shard.
+# On a cluster, run the build step of each shard on a different node and copy the shard files back.
+set -e
+
+shards=${SHARDS:-8}
+numKeys=${NUM_KEYS:-10M}
+bucketSize=${BUCKET_SIZE:-8192}
+overhead=${OVERHEAD:-0.01}
+directory=$(mktemp -d)
+
+./ShardedConstruction generate  --numKeys "$numKeys" --keys "$directory/keys.bin"
+./ShardedConstruction partition --keys "$directory/keys.bin" --shards "$shards" --directory "$directory"
+for ((shard = 0; shard < shards; shard++)); do
+    ./ShardedConstruction build --directory "$directory" --shard "$shard" --shards "$shards" \
+        --bucketSize "$bucketSize" --overhead "$overhead" > "$directory/build-$shard.log" &
+done
+wait
+cat "$directory"/build-*.log | grep RESULT
+./ShardedConstruction merge  --directory "$directory" --shards "$shards" --bucketSize "$bucketSize" --output "$directory/merged.phf"
+./ShardedConstruction verify --keys "$directory/keys.bin" --phf "$directory/merged.phf" --bucketSize "$bucketSize"
+rm -r "$directory"
@@ -0,0 +1,194 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <tlx/cmdline_parser.hpp>
+
+#include "ConsensusRecSplitQueryOptimized.h"
+#include "consensus/ConstexprQuery.h"
+#include "ConstexprQuerySource.h"
+
+constexpr size_t MIN_K = 32;
+constexpr size_t MAX_K = 32768;
+
+template <typename T>
+void writeArray(std::ostream &os, const std::string &type, const std::string &name, const std::vector<T> &values) {
+    os << "inline constexpr std::array<" << type << ", " << values.size() << "> " << name << " = {";
+    for (size_t i = 0; i < values.size(); i++) {
+        os << (i % 8 == 0 ? "\n    " : " ") << "0x" << std::hex << values[i] << std::dec << "ul,";
+    }
+    os << "\n};\n\n";
+}
+
+/**
+ * Arrays of the generated header, which are also used to check the generated query before writing it.
+ */
+struct Exported {
+    consensus::constexpr_query::Parameters parameters;
+    std::vector<uint64_t> seeds;
+    std::vector<consensus::constexpr_query::Level> levels;
+    std::vector<uint32_t> thresholds;
+    std::vector<consensus::constexpr_query::Layer> layers;
+    std::vector<uint64_t> fallbackHashes;
+    std::vector<uint64_t> fallbackResults;
+
+    [[nodiscard]] uint64_t query(uint64_t key) const {
+        return consensus::constexpr_query::query(key, parameters, seeds, levels, thresholds, layers,
+                                                 fallbackHashes, fallbackResults);
+    }
+};
+
+template <size_t k>
+Exported exportFunction(const consensus::ConsensusRecSplitQueryOptimized<k, consensus::RUNTIME_OVERHEAD> &phf) {
+    using BumpingParameters = consensus::DefaultBumpingParameters<k>;
+    const consensus::QueryOptimizedLayout<k> &layout = phf.budget.layout;
+    typename consensus::BumpedKPerfectHashFunction<k>::Arrays bucketing = phf.bucketingPhf->toArrays();
+    Exported exported;
+    exported.parameters = { phf.numKeys, k, phf.logk, layout.totalSize(),
+                            1ul << BumpingParameters::THRESHOLD_BITS, BumpingParameters::THRESHOLD_TRIMMING };
+    std::span<const uint64_t> seeds = phf.unalignedBitVector.words();
+    exported.seeds.assign(seeds.begin(), seeds.end());
+    for (size_t level = 0; level <= phf.logk; level++) {
+        bool lastLevel = level == phf.logk;
+        exported.levels.push_back({ layout.microBitsBeforeLevel(level),
+                                    lastLevel ? 0 : layout.microBitsForSplit(level),
+                                    lastLevel ? 0 : layout.microBitsForFirstSplit(level) });
+    }
+    exported.thresholds = bucketing.thresholds;
+    for (const auto &layer : bucketing.layers) {
+        exported.layers.push_back({ layer.base, layer.expectedThreshold });
+    }
+    exported.fallbackHashes = bucketing.fallbackHashes;
+    exported.fallbackResults = bucketing.fallbackResults;
+    return exported;
+}
+
+/**
+ * The part of ConstexprQuery.h between the markers.
+ */
+std::string_view embeddedQuerySource() {
+    constexpr std::string_view BEGIN = "// CONSTEXPR_QUERY_BEGIN\n";
+    size_t begin = CONSTEXPR_QUERY_SOURCE.find(BEGIN) + BEGIN.size();
+    size_t end = CONSTEXPR_QUERY_SOURCE.find("// CONSTEXPR_QUERY_END");
+    return CONSTEXPR_QUERY_SOURCE.substr(begin, end - begin);
+}
+
+void writeHeader(std::ostream &os, const std::string &name, const std::string &keyFile, const Exported &exported) {
+    const consensus::constexpr_query::Parameters &parameters = exported.parameters;
+    os << "// Generated by CodeGenerator from " << keyFile << ". Do not edit.\n";
+    os << "#pragma once\n\n";
+    os << "#include <array>\n#include <cstdint>\n\n";
+    os << "namespace " << name << " {\n";
+    os << embeddedQuerySource() << "\n";
+    os << "inline constexpr std::uint64_t NUM_KEYS = " << parameters.numKeys << ";\n\n";
+    os << "inline constexpr constexpr_query::Parameters PARAMETERS = { "
+       << parameters.numKeys << "ul, " << parameters.k << "ul, " << parameters.logk << "ul, "
+       << parameters.treeBits << "ul, " << parameters.thresholdRange << "ul, " << parameters.thresholdTrimming << "ul };\n\n";
+    writeArray(os, "std::uint64_t", "SEEDS", exported.seeds);
+    os << "inline constexpr std::array<constexpr_query::Level, " << exported.levels.size() << "> LEVELS = {{";
+    for (const consensus::constexpr_query::Level &level : exported.levels) {
+        os << "\n    { " << level.microBitsBefore << "ul, " << level.microBitsForSplit << "ul, "
+           << level.microBitsForFirstSplit << "ul },";
+    }
+    os << "\n}};\n\n";
+    writeArray(os, "std::uint32_t", "THRESHOLDS", exported.thresholds);
+    os << "inline constexpr std::array<constexpr_query::Layer, " << exported.layers.size() << "> LAYERS = {{";
+    for (const consensus::constexpr_query::Layer &layer : exported.layers) {
+        os << "\n    { " << layer.base << "u, " << layer.expectedThreshold << "u },";
+    }
+    os << "\n}};\n\n";
+    writeArray(os, "std::uint64_t", "FALLBACK_HASHES", exported.fallbackHashes);
+    writeArray(os, "std::uint64_t", "FALLBACK_RESULTS", exported.fallbackResults);
+    os << "/** Returns a unique value in [0, NUM_KEYS) for each of the keys, given as MurmurHash64 of the key. */\n";
+    os << "[[nodiscard]] constexpr std::uint64_t hash(std::uint64_t key) {\n";
+    os << "    return constexpr_query::query(key, PARAMETERS, SEEDS, LEVELS, THRESHOLDS, LAYERS,\n";
+    os << "                                  FALLBACK_HASHES, FALLBACK_RESULTS);\n";
+    os << "}\n\n";
+    os << "[[nodiscard]] constexpr std::uint64_t hash(const char *key, std::uint64_t length) {\n";
+    os << "    return hash(constexpr_query::murmurHash64(key, length));\n";
+    os << "}\n\n";
+    os << "/** For string literals, without the terminating null character. */\n";
+    os << "template <std::uint64_t length>\n";
+    os << "[[nodiscard]] constexpr std::uint64_t hash(const char (&key)[length]) {\n";
+    os << "    return hash(key, length - 1);\n";
+    os << "}\n";
+    os << "} // namespace " << name << "\n";
+}
+
+template <size_t k>
+int generate(const std::string &keyFile, const std::string &outputFile, const std::string &name, double overhead) {
+    std::ifstream is(keyFile);
+    if (!is) {
+        std::cerr << "Unable to open " << keyFile << std::endl;
+        return 1;
+    }
+    std::vector<uint64_t> keys;
+    std::string line;
+    while (std::getline(is, line)) {
+        keys.push_back(bytehamster::util::MurmurHash64(line));
+        if (consensus::constexpr_query::murmurHash64(line.data(), line.size()) != keys.back()) {
+            std::cerr << "The constexpr string hash does not match MurmurHash64" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "Building function for " << keys.size() << " keys" << std::endl;
+    consensus::ConsensusRecSplitQueryOptimized<k, consensus::RUNTIME_OVERHEAD> phf(keys, overhead);
+    Exported exported = exportFunction(phf);
+
+    // The generated header evaluates the same code, so check it here before writing
+    std::vector<bool> taken(keys.size(), false);
+    for (uint64_t key : keys) {
+        size_t hash = exported.query(key);
+        if (hash != phf(key) || hash >= keys.size() || taken[hash]) {
+            std::cerr << "Array representation does not match, duplicate key in input?" << std::endl;
+            return 1;
+        }
+        taken[hash] = true;
+    }
+
+    std::ofstream os(outputFile);
+    writeHeader(os, name, keyFile, exported);
+    if (!os) {
+        std::cerr << "Unable to write " << outputFile << std::endl;
+        return 1;
+    }
+    std::cout << "RESULT N=" << keys.size()
+              << " k=" << k
+              << " overhead=" << overhead
+              << " bitsPerElement=" << (double) phf.getBits() / keys.size()
+              << " fallbackKeys=" << exported.fallbackHashes.size() << std::endl;
+    return 0;
+}
+
+template <size_t k = MAX_K>
+int dispatchBucketSize(size_t param, const std::string &keyFile, const std::string &outputFile,
+                       const std::string &name, double overhead) {
+    if constexpr (k < MIN_K) {
+        std::cerr << "The parameter " << param << " for k was not compiled into this binary." << std::endl;
+        return 1;
+    } else if (k == param) {
+        return generate<k>(keyFile, outputFile, name, overhead);
+    } else {
+        return dispatchBucketSize<k / 2>(param, keyFile, outputFile, name, overhead);
+    }
+}
+
+int main(int argc, const char* const* argv) {
+    std::string keyFile;
+    std::string outputFile;
+    std::string name = "generated_phf";
+    size_t bucketSize = 2048;
+    double overhead = 0.1;
+    tlx::CmdlineParser cmd;
+    cmd.add_string('i', "keys", keyFile, "Text file with one key per line");
+    cmd.add_string('o', "output", outputFile, "Header file to write");
+    cmd.add_string('n', "namespace", name, "Namespace of the generated arrays and hash function");
+    cmd.add_bytes('k', "bucketSize", bucketSize, "Bucket size");
+    cmd.add_double('e', "overhead", overhead, "Overhead parameter");
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+    return dispatchBucketSize(bucketSize, keyFile, outputFile, name, overhead);
+}
@@ -0,0 +1,213 @@
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <bytehamster/util/XorShift64.h>
+#include <tlx/cmdline_parser.hpp>
+
+#include "ShardedConsensusRecSplit.h"
+#include "consensus/Validation.h"
+
+// Parameters of all shards. Shard files contain them, so mismatches are detected when merging.
+template <size_t k>
+using ShardedPhf = consensus::ShardedConsensusRecSplit<k, consensus::RUNTIME_OVERHEAD>;
+constexpr size_t MIN_K = 32;
+constexpr size_t MAX_K = 32768;
+
+/**
+ * Calls the command with the bucket size given at runtime as template argument.
+ */
+template <size_t k = MAX_K, typename Command>
+int dispatchBucketSize(size_t param, Command command) {
+    if constexpr (k < MIN_K) {
+        std::cerr << "The parameter " << param << " for k was not compiled into this binary." << std::endl;
+        return 1;
+    } else if (k == param) {
+        return command.template operator()<k>();
+    } else {
+        return dispatchBucketSize<k / 2>(param, command);
+    }
+}
+
+// Key files are raw arrays of 64-bit hash values.
+std::vector<uint64_t> readKeyFile(const std::filesystem::path &path) {
+    std::ifstream is(path, std::ios::binary);
+    if (!is) {
+        throw std::runtime_error("Unable to open " + path.string());
+    }
+    std::vector<uint64_t> keys(std::filesystem::file_size(path) / sizeof(uint64_t));
+    is.read(reinterpret_cast<char *>(keys.data()), std::streamsize(keys.size() * sizeof(uint64_t)));
+    return keys;
+}
+
+std::filesystem::path shardKeyFile(const std::filesystem::path &directory, size_t shard) {
+    return directory / ("shard-" + std::to_string(shard) + ".keys");
+}
+
+std::filesystem::path shardPhfFile(const std::filesystem::path &directory, size_t shard) {
+    return directory / ("shard-" + std::to_string(shard) + ".phf");
+}
+
+int generate(int argc, const char* const* argv) {
+    size_t numKeys = 1e6;
+    size_t seed = 42;
+    std::string keyFile;
+    tlx::CmdlineParser cmd;
+    cmd.add_bytes('n', "numKeys", numKeys, "Number of keys to generate");
+    cmd.add_size_t('s', "seed", seed, "Seed of the random number generator");
+    cmd.add_string('i', "keys", keyFile, "Key file to write");
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+    bytehamster::util::XorShift64 prng(seed);
+    std::ofstream os(keyFile, std::ios::binary);
+    for (size_t i = 0; i < numKeys; i++) {
+        uint64_t key = prng();
+        os.write(reinterpret_cast<const char *>(&key), sizeof(uint64_t));
+    }
+    return 0;
+}
+
+int partition(int argc, const char* const* argv) {
+    std::string keyFile;
+    std::string directory;
+    size_t numShards = 4;
+    tlx::CmdlineParser cmd;
+    cmd.add_string('i', "keys", keyFile, "Key file to partition");
+    cmd.add_string('d', "directory", directory, "Directory for the shard files");
+    cmd.add_size_t('s', "shards", numShards, "Number of shards");
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+    std::vector<std::ofstream> shardFiles;
+    for (size_t shard = 0; shard < numShards; shard++) {
+        shardFiles.emplace_back(shardKeyFile(directory, shard), std::ios::binary | std::ios::trunc);
+    }
+    // Stream through the input, so that the coordinator does not need to hold all keys in memory
+    std::ifstream is(keyFile, std::ios::binary);
+    std::vector<uint64_t> buffer(1 << 16);
+    while (is) {
+        is.read(reinterpret_cast<char *>(buffer.data()), std::streamsize(buffer.size() * sizeof(uint64_t)));
+        size_t keysRead = is.gcount() / sizeof(uint64_t);
+        for (size_t i = 0; i < keysRead; i++) {
+            // Independent of the parameters
+            size_t shard = ShardedPhf<MAX_K>::shardOf(buffer[i], numShards);
+            shardFiles[shard].write(reinterpret_cast<const char *>(&buffer[i]), sizeof(uint64_t));
+        }
+    }
+    return 0;
+}
+
+int build(int argc, const char* const* argv) {
+    std::string directory;
+    size_t shard = 0;
+    size_t numShards = 4;
+    size_t bucketSize = 8192;
+    double overhead = 0.01;
+    tlx::CmdlineParser cmd;
+    cmd.add_string('d', "directory", directory, "Directory of the shard files");
+    cmd.add_size_t('x', "shard", shard, "Index of the shard to build");
+    cmd.add_size_t('s', "shards", numShards, "Number of shards");
+    cmd.add_bytes('k', "bucketSize", bucketSize, "Bucket size, must be the same for all shards");
+    cmd.add_double('e', "overhead", overhead, "Overhead parameter");
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+    std::vector<uint64_t> keys = readKeyFile(shardKeyFile(directory, shard));
+    auto begin = std::chrono::high_resolution_clock::now();
+    std::ofstream os(shardPhfFile(directory, shard), std::ios::binary | std::ios::trunc);
+    int status = dispatchBucketSize(bucketSize, [&]<size_t k>() {
+        ShardedPhf<k>::constructShard(os, shard, numShards, keys, overhead);
+        return 0;
+    });
+    if (status != 0) {
+        return status;
+    }
+    unsigned long durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - begin).count();
+    std::cout << "RESULT shard=" << shard << " N=" << keys.size()
+              << " constructionTimeMilliseconds=" << durationMs << std::endl;
+    return 0;
+}
+
+int merge(int argc, const char* const* argv) {
+    std::string directory;
+    std::string outputFile;
+    size_t numShards = 4;
+    size_t bucketSize = 8192;
+    tlx::CmdlineParser cmd;
+    cmd.add_string('d', "directory", directory, "Directory of the shard files");
+    cmd.add_size_t('s', "shards", numShards, "Number of shards");
+    cmd.add_bytes('k', "bucketSize", bucketSize, "Bucket size that the shards were built with");
+    cmd.add_string('o', "output", outputFile, "Merged file to write");
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+    std::vector<std::filesystem::path> shardFiles;
+    for (size_t shard = 0; shard < numShards; shard++) {
+        shardFiles.push_back(shardPhfFile(directory, shard));
+    }
+    std::ofstream os(outputFile, std::ios::binary | std::ios::trunc);
+    return dispatchBucketSize(bucketSize, [&]<size_t k>() {
+        ShardedPhf<k>::merge(shardFiles, os);
+        return 0;
+    });
+}
+
+template <typename Phf>
+int verifyMerged(const std::string &keyFile, const Phf &phf) {
+    std::vector<uint64_t> keys = readKeyFile(keyFile);
+    if (phf.numKeys() != keys.size()) {
+        std::cerr << "Number of keys does not match" << std::endl;
+        return 1;
+    }
+    consensus::SpanKeySource source(keys);
+    consensus::ValidationResult validation = consensus::validate(phf, keys.size(), source);
+    if (validation.outOfRange > 0) {
+        std::cerr << "Out of range by key " << validation.firstOutOfRange.front() << "!" << std::endl;
+        return 1;
+    } else if (validation.collisions > 0) {
+        std::cerr << "Collision by key " << validation.firstCollisions.front().keyIndices.back() << "!" << std::endl;
+        return 1;
+    }
+    std::cout << "RESULT shards=" << phf.numShards() << " N=" << keys.size()
+              << " bitsPerElement=" << (double) phf.getBits() / keys.size() << std::endl;
+    return 0;
+}
+
+int verify(int argc, const char* const* argv) {
+    std::string keyFile;
+    std::string inputFile;
+    size_t bucketSize = 8192;
+    tlx::CmdlineParser cmd;
+    cmd.add_string('i', "keys", keyFile, "Key file");
+    cmd.add_string('p', "phf", inputFile, "Merged file to check");
+    cmd.add_bytes('k', "bucketSize", bucketSize, "Bucket size that the shards were built with");
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+    return dispatchBucketSize(bucketSize, [&]<size_t k>() {
+        std::ifstream is(inputFile, std::ios::binary);
+        return verifyMerged(keyFile, ShardedPhf<k>(is));
+    });
+}
+
+int main(int argc, const char* const* argv) {
+    std::string command = argc >= 2 ? argv[1] : "";
+    if (command == "generate") {
+        return generate(argc - 1, argv + 1);
+    } else if (command == "partition") {
+        return partition(argc - 1, argv + 1);
+    } else if (command == "build") {
+        return build(argc - 1, argv + 1);
+    } else if (command == "merge") {
+        return merge(argc - 1, argv + 1);
+    } else if (command == "verify") {
+        return verify(argc - 1, argv + 1);
+    }
+    std::cerr << "Usage: " << argv[0] << " generate|partition|build|merge|verify [options]" << std::endl;
+    return 1;
+}
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <bytehamster/util/MurmurHash64.h>
+#include <tlx/cmdline_parser.hpp>
+
+#include "DynamicConsensusRecSplit.h"
+#include "consensus/Validation.h"
+
+/**
+ * Binary file of native-endian 64-bit integers. Integers are hashed like in the benchmark,
+ * hash values are used as they are, like in ShardedConstruction.
+ */
+class BinaryKeyFileSource {
+        static constexpr size_t CHUNK_SIZE = 1ul << 16;
+        std::ifstream is;
+        bool hashIntegers;
+        size_t numRead = 0;
+        std::mutex mutex;
+    public:
+        BinaryKeyFileSource(const std::string &file, bool hashIntegers)
+                : is(file, std::ios::binary), hashIntegers(hashIntegers) {
+            if (!is) {
+                throw std::runtime_error("Unable to open " + file);
+            }
+        }
+
+        bool next(consensus::KeyChunk &chunk) {
+            chunk.storage.resize(CHUNK_SIZE);
+            {
+                std::lock_guard lock(mutex);
+                is.read(reinterpret_cast<char *>(chunk.storage.data()), std::streamsize(CHUNK_SIZE * sizeof(uint64_t)));
+                if (is.gcount() % sizeof(uint64_t) != 0) {
+                    throw std::invalid_argument("File size is not a multiple of 8 bytes");
+                }
+                chunk.storage.resize(is.gcount() / sizeof(uint64_t));
+                chunk.firstIndex = numRead;
+                numRead += chunk.storage.size();
+            }
+            if (hashIntegers) {
+                for (uint64_t &key : chunk.storage) {
+                    key = bytehamster::util::MurmurHash64(&key, sizeof(key));
+                }
+            }
+            chunk.keys = chunk.storage;
+            return !chunk.storage.empty();
+        }
+
+        void rewind() {
+            std::lock_guard lock(mutex);
+            is.clear();
+            is.seekg(0);
+            numRead = 0;
+        }
+};
+
+/**
+ * Newline-separated strings. Like in the benchmark, empty lines are skipped and a trailing \r is removed.
+ * Only splitting the file into blocks of whole lines is serialized, the threads hash their blocks in parallel.
+ */
+class LineKeyFileSource {
+        static constexpr size_t BLOCK_SIZE = 4ul << 20;
+        std::ifstream is;
+        std::string carry; // Incomplete line at the end of the previous block
+        size_t numRead = 0;
+        std::mutex mutex;
+    public:
+        explicit LineKeyFileSource(const std::string &file) : is(file, std::ios::binary) {
+            if (!is) {
+                throw std::runtime_error("Unable to open " + file);
+            }
+        }
+
+        bool next(consensus::KeyChunk &chunk) {
+            {
+                std::lock_guard lock(mutex);
+                chunk.buffer.assign(carry.begin(), carry.end());
+                size_t end = 0; // Bytes of complete lines, the last line of the file may end without newline
+                while (end == 0) {
+                    size_t oldSize = chunk.buffer.size();
+                    chunk.buffer.resize(oldSize + BLOCK_SIZE);
+                    is.read(chunk.buffer.data() + oldSize, BLOCK_SIZE);
+                    chunk.buffer.resize(oldSize + is.gcount());
+                    if (!is) {
+                        end = chunk.buffer.size();
+                        break;
+                    }
+                    end = std::find(chunk.buffer.rbegin(), chunk.buffer.rend(), '\n').base() - chunk.buffer.begin();
+                }
+                carry.assign(chunk.buffer.begin() + end, chunk.buffer.end());
+                chunk.buffer.resize(end);
+                chunk.firstIndex = numRead;
+                numRead += forEachLine(chunk.buffer, [](std::string_view) { });
+            }
+            chunk.storage.clear();
+            forEachLine(chunk.buffer, [&](std::string_view line) {
+                chunk.storage.push_back(bytehamster::util::MurmurHash64(line.data(), line.size()));
+            });
+            chunk.keys = chunk.storage;
+            return !chunk.buffer.empty();
+        }
+
+        void rewind() {
+            std::lock_guard lock(mutex);
+            is.clear();
+            is.seekg(0);
+            carry.clear();
+            numRead = 0;
+        }
+
+        /**
+         * Returns the number of non-empty lines.
+         */
+        template <typename Function>
+        static size_t forEachLine(std::span<const char> buffer, Function function) {
+            std::string_view remaining(buffer.data(), buffer.size());
+            size_t numLines = 0;
+            while (!remaining.empty()) {
+                size_t end = remaining.find('\n');
+                std::string_view line = remaining.substr(0, end);
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+                if (!line.empty()) {
+                    function(line);
+                    numLines++;
+                }
+                remaining.remove_prefix(end == std::string_view::npos ? remaining.size() : end + 1);
+            }
+            return numLines;
+        }
+};
+
+/**
+ * Looks up the keys with the given indices, only used for reporting errors.
+ */
+std::map<size_t, std::string> describeKeys(const std::string &keyFile, const std::string &format,
+                                           const consensus::ValidationResult &result) {
+    std::map<size_t, std::string> keys;
+    for (size_t index : result.firstOutOfRange) {
+        keys[index] = "";
+    }
+    for (const consensus::Collision &collision : result.firstCollisions) {
+        for (size_t index : collision.keyIndices) {
+            keys[index] = "";
+        }
+    }
+    std::ifstream is(keyFile, std::ios::binary);
+    if (format == "lines") {
+        std::string line;
+        size_t index = 0;
+        while (std::getline(is, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                continue;
+            }
+            if (keys.contains(index)) {
+                keys[index] = "\"" + line + "\"";
+            }
+            index++;
+        }
+    } else {
+        for (auto &[index, description] : keys) {
+            uint64_t key = 0;
+            is.seekg(std::streamoff(index * sizeof(uint64_t)));
+            is.read(reinterpret_cast<char *>(&key), sizeof(key));
+            description = std::to_string(key);
+        }
+    }
+    return keys;
+}
+
+int validateFile(const std::string &phfFile, const std::string &keyFile, const std::string &format,
+                 size_t numThreads, size_t maxReported) {
+    std::ifstream phfStream(phfFile, std::ios::binary);
+    if (!phfStream) {
+        std::cerr << "Unable to open " << phfFile << std::endl;
+        return 1;
+    }
+    std::cout << "Loading " << phfFile << std::endl;
+    consensus::DynamicConsensusRecSplit phf(phfStream);
+    const consensus::DynamicConsensusRecSplit::Parameters &parameters = phf.getParameters();
+
+    std::cout << "Validating with " << numThreads << " threads" << std::endl;
+    consensus::ValidationResult result;
+    if (format == "lines") {
+        LineKeyFileSource source(keyFile);
+        result = consensus::validate(phf, phf.getNumKeys(), source, numThreads, maxReported);
+    } else {
+        BinaryKeyFileSource source(keyFile, format == "integers");
+        result = consensus::validate(phf, phf.getNumKeys(), source, numThreads, maxReported);
+    }
+
+    if (result.numKeys != result.expectedKeys) {
+        std::cout << "The function was built for " << result.expectedKeys << " keys, but the file contains "
+                  << result.numKeys << std::endl;
+    }
+    if (!result.firstOutOfRange.empty() || !result.firstCollisions.empty()) {
+        std::map<size_t, std::string> keys = describeKeys(keyFile, format, result);
+        for (size_t index : result.firstOutOfRange) {
+            std::cout << "Out of range: key " << index << " " << keys[index] << std::endl;
+        }
+        for (const consensus::Collision &collision : result.firstCollisions) {
+            std::cout << "Collision at position " << collision.position << ":";
+            for (size_t index : collision.keyIndices) {
+                std::cout << " key " << index << " " << keys[index];
+            }
+            std::cout << std::endl;
+        }
+    }
+    std::cout << "RESULT"
+              << " method=Consensus" << (parameters.variant == consensus::DynamicConsensusRecSplit::Variant::QueryOptimized
+                                         ? "QueryOptimized" : "")
+              << " k=" << parameters.k
+              << " overhead=" << parameters.overhead
+              << " N=" << result.numKeys
+              << " threads=" << numThreads
+              << " validationTimeMilliseconds="
+                    << std::chrono::duration_cast<std::chrono::milliseconds>(result.duration).count()
+              << " keysPerSecond=" << result.keysPerSecond()
+              << " outOfRange=" << result.outOfRange
+              << " collisions=" << result.collisions
+              << " valid=" << result.isMinimalPerfect()
+              << std::endl;
+    return result.isMinimalPerfect() ? 0 : 1;
+}
+
+int main(int argc, const char* const* argv) {
+    std::string phfFile;
+    std::string keyFile;
+    std::string format = "lines";
+    size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+    size_t maxReported = 10;
+    tlx::CmdlineParser cmd;
+    cmd.add_string('p', "phf", phfFile, "Serialized ConsensusRecSplit or ConsensusRecSplitQueryOptimized");
+    cmd.add_string('i', "keys", keyFile, "Key file the function was built from");
+    cmd.add_string('f', "format", format, "Format of the key file: lines, integers (hashed) or hashes (used as they are)");
+    cmd.add_size_t('t', "threads", numThreads, "Number of threads");
+    cmd.add_size_t('r', "report", maxReported, "Number of colliding positions and out of range keys to report");
+    if (!cmd.process(argc, argv)) {
+        return 1;
+    }
+    if (format != "lines" && format != "integers" && format != "hashes") {
+        std::cerr << "Unknown format " << format << std::endl;
+        return 1;
+    }
+
+    try {
+        return validateFile(phfFile, keyFile, format, numThreads, maxReported);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}